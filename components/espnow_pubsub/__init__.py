@@ -30,42 +30,202 @@ from esphome.const import (
     CONF_TRIGGER_ID,
 )
 from esphome.core import CORE
+from esphome.helpers import cpp_string_escape
 
 espnow_pubsub_ns = cg.esphome_ns.namespace("espnow_pubsub")
 
 DEPENDENCIES = ["espnow"]
 
 EspNowPubSub = espnow_pubsub_ns.class_("EspNowPubSub", cg.Component)
+OverflowPolicy = espnow_pubsub_ns.enum("OverflowPolicy")
+MessagePriority = espnow_pubsub_ns.enum("MessagePriority")
+MESSAGE_PRIORITIES = {
+    "high": MessagePriority.PRIORITY_HIGH,
+    "normal": MessagePriority.PRIORITY_NORMAL,
+    "low": MessagePriority.PRIORITY_LOW,
+}
+SubscriptionOptions = espnow_pubsub_ns.struct("SubscriptionOptions")
+PayloadFilter = espnow_pubsub_ns.struct("PayloadFilter")
+MessageInfo = espnow_pubsub_ns.struct("MessageInfo")
+TopicCaptures = espnow_pubsub_ns.struct("TopicCaptures")
+OwnedTopicCaptures = espnow_pubsub_ns.class_("OwnedTopicCaptures")
+DispatchMode = espnow_pubsub_ns.enum("DispatchMode")
+DISPATCH_MODES = {
+    "all": DispatchMode.DISPATCH_ALL,
+    "first_match": DispatchMode.DISPATCH_FIRST_MATCH,
+}
+OVERFLOW_POLICIES = {
+    "drop_oldest": OverflowPolicy.OVERFLOW_DROP_OLDEST,
+    "drop_newest": OverflowPolicy.OVERFLOW_DROP_NEWEST,
+    "coalesce": OverflowPolicy.OVERFLOW_COALESCE,
+}
+TopicIndex = espnow_pubsub_ns.class_("TopicIndex")
+std_string_view = cg.std_ns.class_("string_view")
 # Triggers
+SubscriptionTrigger = espnow_pubsub_ns.class_("SubscriptionTrigger")
 OnMessageTrigger = espnow_pubsub_ns.class_(
-    "OnMessageTrigger", automation.Trigger.template(cg.std_string, cg.std_string, cg.uint32)
+    "OnMessageTrigger",
+    automation.Trigger.template(cg.std_string, cg.std_string, cg.uint32, MessageInfo, OwnedTopicCaptures),
+    SubscriptionTrigger,
+)
+OnViewMessageTrigger = espnow_pubsub_ns.class_(
+    "OnViewMessageTrigger",
+    automation.Trigger.template(std_string_view, std_string_view, cg.uint32, MessageInfo, TopicCaptures),
+    SubscriptionTrigger,
+)
+OnBinaryMessageTrigger = espnow_pubsub_ns.class_(
+    "OnBinaryMessageTrigger",
+    automation.Trigger.template(
+        std_string_view, cg.uint8.operator("ptr").operator("const"), cg.size_t, cg.uint32, MessageInfo, TopicCaptures
+    ),
+    SubscriptionTrigger,
 )
 # Actions
 EspnowPubSubPublishAction = espnow_pubsub_ns.class_("EspnowPubSubPublishAction", automation.Action)
+EspnowPubSubSubscribeAction = espnow_pubsub_ns.class_("EspnowPubSubSubscribeAction", automation.Action)
+EspnowPubSubUnsubscribeAction = espnow_pubsub_ns.class_("EspnowPubSubUnsubscribeAction", automation.Action)
 
-ON_MESSAGE_SCHEMA = automation.validate_automation(
+# Payload conditions checked natively before the trigger fires; all given ones must hold
+FILTER_SCHEMA = cv.Schema(
+    {
+        cv.Optional("equals"): cv.string,
+        cv.Optional("prefix"): cv.string,
+        cv.Optional("range"): cv.All(
+            cv.Schema(
+                {
+                    cv.Optional("min"): cv.float_,
+                    cv.Optional("max"): cv.float_,
+                }
+            ),
+            cv.has_at_least_one_key("min", "max"),
+        ),
+        cv.Optional("changed", default=False): cv.boolean,
+    }
+)
+
+# Options shared by on_message, on_view_message and on_binary_message
+SUBSCRIPTION_SCHEMA = cv.Schema(
     {
-        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(OnMessageTrigger),
         cv.Required(CONF_TOPIC): cv.string,
+        cv.Optional("priority", default="normal"): cv.enum(MESSAGE_PRIORITIES, lower=True),
+        cv.Optional("max_age", default="0ms"): cv.positive_time_period_milliseconds,
+        # false: declared but paused until an espnow_pubsub.subscribe action resumes it
+        cv.Optional("subscribed", default=True): cv.boolean,
+        cv.Optional("filter"): FILTER_SCHEMA,
+        # Matches are dispatched by ascending order, then as declared
+        cv.Optional("order", default=0): cv.int_range(min=-32768, max=32767),
+        # Skip the remaining matches once this subscription fired
+        cv.Optional("exclusive", default=False): cv.boolean,
+    }
+)
+
+ON_MESSAGE_SCHEMA = automation.validate_automation(
+    SUBSCRIPTION_SCHEMA.extend(
+        {
+            cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(OnMessageTrigger),
+        }
+    )
+)
+# Zero-copy variant: topic and payload are std::string_view into the receive queue slot
+ON_VIEW_MESSAGE_SCHEMA = automation.validate_automation(
+    SUBSCRIPTION_SCHEMA.extend(
+        {
+            cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(OnViewMessageTrigger),
+        }
+    )
+)
+# Binary variant: payload delivered as (const uint8_t *data, size_t size)
+ON_BINARY_MESSAGE_SCHEMA = automation.validate_automation(
+    SUBSCRIPTION_SCHEMA.extend(
+        {
+            cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(OnBinaryMessageTrigger),
+        }
+    )
+)
+
+
+def validate_alias_topic(value):
+    value = cv.string(value)
+    if not value:
+        raise cv.Invalid("Aliased topic must not be empty")
+    if "+" in value or "#" in value:
+        raise cv.Invalid("Aliased topic must not contain wildcards")
+    return value
+
+
+def validate_topic_aliases(value):
+    topics = set()
+    aliases = set()
+    for entry in value:
+        if entry[CONF_TOPIC] in topics:
+            raise cv.Invalid(f"Topic '{entry[CONF_TOPIC]}' has more than one alias")
+        if entry["alias"] in aliases:
+            raise cv.Invalid(f"Alias {entry['alias']} is used for more than one topic")
+        topics.add(entry[CONF_TOPIC])
+        aliases.add(entry["alias"])
+    return value
+
+
+TOPIC_ALIAS_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_TOPIC): validate_alias_topic,
+        cv.Required("alias"): cv.uint16_t,
     }
 )
 
+
+DYNAMIC_ALIASES_SCHEMA = cv.Schema(
+    {
+        cv.Optional("max_topics", default=32): cv.int_range(min=1, max=1024),
+        cv.Optional("announce_interval", default="60s"): cv.positive_time_period_milliseconds,
+    }
+)
+
+
+def validate_raw_data(value):
+    if isinstance(value, str):
+        return value.encode("utf-8")
+    if isinstance(value, list):
+        return cv.Schema([cv.hex_uint8_t])(value)
+    raise cv.Invalid("data must either be a string wrapped in quotes or a list of bytes")
+
+
 CONFIG_SCHEMA = cv.Schema(
     {
         cv.GenerateID(): cv.declare_id(EspNowPubSub),
         cv.Optional("send_times", default=1): cv.int_range(min=1, max=10),
+        cv.Optional("queue_size", default=16): cv.int_range(min=1, max=64),
+        cv.Optional("high_priority_queue_size", default=4): cv.int_range(min=1, max=64),
+        cv.Optional("low_priority_queue_size", default=8): cv.int_range(min=1, max=64),
+        cv.Optional("overflow_policy", default="drop_oldest"): cv.enum(OVERFLOW_POLICIES, lower=True),
+        cv.Optional("dispatch_budget", default="10ms"): cv.positive_time_period_milliseconds,
+        cv.Optional("dispatch_max_messages", default=0): cv.int_range(min=0, max=64),
+        cv.Optional("dispatch_mode", default="all"): cv.enum(DISPATCH_MODES, lower=True),
+        cv.Optional("status_interval", default="1s"): cv.positive_time_period_milliseconds,
+        cv.Optional("peer_capacity", default=128): cv.int_range(min=1, max=1024),
+        cv.Optional("peer_timeout", default="1h"): cv.positive_time_period_milliseconds,
+        cv.Optional("match_cache_size", default=16): cv.int_range(min=0, max=256),
+        cv.Optional("topic_aliases", default=[]): cv.All(cv.ensure_list(TOPIC_ALIAS_SCHEMA), validate_topic_aliases),
+        cv.Optional("dynamic_aliases"): DYNAMIC_ALIASES_SCHEMA,
+        cv.Optional("alias_cache_size", default=16): cv.int_range(min=0, max=1024),
         cv.Optional("on_message"): cv.ensure_list(ON_MESSAGE_SCHEMA),
+        cv.Optional("on_view_message"): cv.ensure_list(ON_VIEW_MESSAGE_SCHEMA),
+        cv.Optional("on_binary_message"): cv.ensure_list(ON_BINARY_MESSAGE_SCHEMA),
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
 @automation.register_action(
     "espnow_pubsub.publish",
     EspnowPubSubPublishAction,
-    cv.Schema(
-        {
-            cv.Required(CONF_TOPIC): cv.templatable(cv.string),
-            cv.Required("payload"): cv.templatable(cv.string),
-        }
+    cv.All(
+        cv.Schema(
+            {
+                cv.Required(CONF_TOPIC): cv.templatable(cv.string),
+                cv.Exclusive("payload", "payload"): cv.templatable(cv.string),
+                cv.Exclusive("data", "payload"): cv.templatable(validate_raw_data),
+            }
+        ),
+        cv.has_exactly_one_key("payload", "data"),
     ),
     synchronous=False,
 )
@@ -92,34 +252,255 @@ async def espnow_pubsub_publish_action_to_code(config, action_id, template_arg,
     var = cg.new_Pvariable(action_id, template_arg, parent)
     topic = await cg.templatable(config["topic"], args, cg.std_string)
     cg.add(var.set_topic(topic))
-    payload = await cg.templatable(config["payload"], args, cg.std_string)
-    cg.add(var.set_payload(payload))
+    if "data" in config:
+        data = config["data"]
+        if cg.is_template(data):
+            data = await cg.templatable(data, args, cg.std_vector.template(cg.uint8))
+        else:
+            data = cg.std_vector.template(cg.uint8)(list(data))
+        cg.add(var.set_data(data))
+    else:
+        payload = await cg.templatable(config["payload"], args, cg.std_string)
+        cg.add(var.set_payload(payload))
     return var
 
+# subscribe/unsubscribe resume and pause a declared subscription, referenced by its trigger_id
+SUBSCRIPTION_ACTION_SCHEMA = cv.maybe_simple_value(
+    {
+        cv.Required(CONF_ID): cv.use_id(SubscriptionTrigger),
+    },
+    key=CONF_ID,
+)
+
+@automation.register_action("espnow_pubsub.subscribe", EspnowPubSubSubscribeAction, SUBSCRIPTION_ACTION_SCHEMA)
+@automation.register_action("espnow_pubsub.unsubscribe", EspnowPubSubUnsubscribeAction, SUBSCRIPTION_ACTION_SCHEMA)
+async def espnow_pubsub_subscription_action_to_code(config, action_id, template_arg, args):
+    trigger = await cg.get_variable(config[CONF_ID])
+    return cg.new_Pvariable(action_id, template_arg, trigger)
+
 async def to_code(config):
     cg.add_define("USE_ESPNOW_PUBSUB")
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
     cg.add(var.set_send_times(config["send_times"]))
+    cg.add(var.set_queue_size(config["queue_size"]))
+    cg.add(var.set_priority_queue_size(MessagePriority.PRIORITY_HIGH, config["high_priority_queue_size"]))
+    cg.add(var.set_priority_queue_size(MessagePriority.PRIORITY_LOW, config["low_priority_queue_size"]))
+    cg.add(var.set_overflow_policy(config["overflow_policy"]))
+    cg.add(var.set_dispatch_budget(config["dispatch_budget"]))
+    cg.add(var.set_dispatch_max_messages(config["dispatch_max_messages"]))
+    cg.add(var.set_dispatch_mode(config["dispatch_mode"]))
+    cg.add(var.set_status_interval(config["status_interval"]))
+    cg.add(var.set_peer_capacity(config["peer_capacity"]))
+    cg.add(var.set_peer_timeout(config["peer_timeout"]))
+    cg.add(var.set_match_cache_size(config["match_cache_size"]))
+    for alias_conf in config["topic_aliases"]:
+        cg.add(var.add_topic_alias(alias_conf[CONF_TOPIC], alias_conf["alias"]))
+    if "dynamic_aliases" in config:
+        dynamic_conf = config["dynamic_aliases"]
+        cg.add(var.set_dynamic_aliases(dynamic_conf["max_topics"], dynamic_conf["announce_interval"]))
+    cg.add(var.set_alias_cache_size(config["alias_cache_size"]))
+
+    subscriptions = _collect_subscriptions(
+        config.get("on_message", []),
+        [
+            (cg.std_string, "topic"),
+            (cg.std_string, "payload"),
+            (cg.uint32, "sequence"),
+            (MessageInfo, "info"),
+            (OwnedTopicCaptures, "captures"),
+        ],
+    )
+    subscriptions += _collect_subscriptions(
+        config.get("on_view_message", []),
+        [
+            (std_string_view, "topic"),
+            (std_string_view, "payload"),
+            (cg.uint32, "sequence"),
+            (MessageInfo, "info"),
+            (TopicCaptures, "captures"),
+        ],
+    )
+    subscriptions += _collect_subscriptions(
+        config.get("on_binary_message", []),
+        [
+            (std_string_view, "topic"),
+            (cg.uint8.operator("ptr").operator("const"), "data"),
+            (cg.size_t, "size"),
+            (cg.uint32, "sequence"),
+            (MessageInfo, "info"),
+            (TopicCaptures, "captures"),
+        ],
+    )
+    # Register in dispatch order (stable, so equal orders keep their declaration order); the
+    # component relies on it to keep the compiled topic index
+    subscriptions.sort(key=lambda sub: sub[0]["order"])
+    topics = await _build_subscriptions(var, subscriptions)
+    _emit_topic_index(var, str(config[CONF_ID]), topics)
 
-    for conf in config.get("on_message", []):
+def _collect_subscriptions(confs, args):
+    subscriptions = []
+    for conf in confs:
         # Fix: conf may be a list if schema is not flattened
-        if isinstance(conf, list):
-            for sub_conf in conf:
-                trigger = cg.new_Pvariable(sub_conf[CONF_TRIGGER_ID], var, sub_conf[CONF_TOPIC])
-                cg.add(var.add_subscription(sub_conf[CONF_TOPIC], trigger))
-                await automation.build_automation(
-                    trigger,
-                    [(cg.std_string, "topic"), (cg.std_string, "payload"), (cg.uint32, "sequence")],
-                    sub_conf,
-                )
+        for sub_conf in conf if isinstance(conf, list) else [conf]:
+            subscriptions.append((sub_conf, args))
+    return subscriptions
+
+async def _build_subscriptions(var, subscriptions):
+    topics = []
+    for sub_conf, args in subscriptions:
+        trigger = cg.new_Pvariable(sub_conf[CONF_TRIGGER_ID], var, sub_conf[CONF_TOPIC])
+        options = cg.StructInitializer(
+            SubscriptionOptions,
+            ("priority", sub_conf["priority"]),
+            ("max_age", sub_conf["max_age"]),
+            ("subscribed", sub_conf["subscribed"]),
+            ("filter", _build_filter(sub_conf.get("filter", {}))),
+            ("order", sub_conf["order"]),
+            ("exclusive", sub_conf["exclusive"]),
+        )
+        cg.add(var.add_subscription(sub_conf[CONF_TOPIC], trigger, options))
+        # Only wildcard subscriptions go into the topic index (exact ones are hashed at setup);
+        # paused ones keep their id but stay out of it
+        topic = sub_conf[CONF_TOPIC]
+        wildcard = "+" in topic or "#" in topic
+        topics.append(topic if sub_conf["subscribed"] and wildcard else None)
+        await automation.build_automation(trigger, args, sub_conf)
+    return topics
+
+
+def _build_filter(config):
+    checks = []
+    fields = []
+    if "equals" in config:
+        checks.append("CHECK_EQUALS")
+        fields.append(("equals", config["equals"]))
+    if "prefix" in config:
+        checks.append("CHECK_PREFIX")
+        fields.append(("prefix", config["prefix"]))
+    if "range" in config:
+        checks.append("CHECK_RANGE")
+        if "min" in config["range"]:
+            fields.append(("min", config["range"]["min"]))
+        if "max" in config["range"]:
+            fields.append(("max", config["range"]["max"]))
+    if config.get("changed", False):
+        checks.append("CHECK_CHANGED")
+    mask = " | ".join(f"{PayloadFilter}::{check}" for check in checks) or "0"
+    return cg.StructInitializer(PayloadFilter, ("checks", cg.RawExpression(mask)), *fields)
+
+
+TOPIC_INDEX_NO_NODE = 0xFFFF
+
+
+def _topic_hash(level):
+    """FNV-1a, same as topic_hash() in topic_index.h."""
+    value = 2166136261
+    for byte in level:
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def _compile_topic_index(patterns):
+    """Build the TopicIndex tables for patterns (subscription i = patterns[i]).
+
+    Mirrors TopicIndex::add() and TopicIndex::finalize(), so the result can be loaded as is.
+    Patterns that are None (paused or exact subscriptions) are left out.
+    """
+    build = [{"children": [], "plus": None, "end": [], "hash": []}]
+    for sub_id, pattern in enumerate(patterns):
+        if pattern is None:
+            continue
+        pattern = pattern.encode("utf-8")
+        hash_pos = pattern.find(b"#")
+        if hash_pos not in (-1, len(pattern) - 1):
+            continue  # '#' not last never matches
+        node = 0
+        pos = 0
+        while pos < len(pattern):
+            end = pattern.find(b"/", pos)
+            end = len(pattern) if end == -1 else end
+            level = pattern[pos:end]
+            if level == b"#":
+                build[node]["hash"].append(sub_id)
+                break
+            if level == b"+":
+                child = build[node]["plus"]
+            else:
+                child = next((c for text, c in build[node]["children"] if text == level), None)
+            if child is None:
+                child = len(build)
+                if level == b"+":
+                    build[node]["plus"] = child
+                else:
+                    build[node]["children"].append((level, child))
+                build.append({"children": [], "plus": None, "end": [], "hash": []})
+            node = child
+            pos = end + 1 if end < len(pattern) else end
         else:
-            trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var, conf[CONF_TOPIC])
-            cg.add(var.add_subscription(conf[CONF_TOPIC], trigger))
-            await automation.build_automation(
-                trigger,
-                [(cg.std_string, "topic"), (cg.std_string, "payload"), (cg.uint32, "sequence")],
-                conf,
+            build[node]["end"].append(sub_id)
+
+    # Breadth-first numbering keeps each node's literal children contiguous
+    order = [0]
+    for b in order:
+        order.extend(c for _, c in build[b]["children"])
+        if build[b]["plus"] is not None:
+            order.append(build[b]["plus"])
+    flat_index = {b: i for i, b in enumerate(order)}
+
+    nodes, edges, subs, levels = [], [], [], b""
+    for b in order:
+        src = build[b]
+        node_edges = []
+        for text, child in src["children"]:
+            node_edges.append((_topic_hash(text), len(levels), len(text), flat_index[child]))
+            levels += text
+        node_edges.sort(key=lambda e: e[0])
+        plus = TOPIC_INDEX_NO_NODE if src["plus"] is None else flat_index[src["plus"]]
+        nodes.append((len(edges), len(node_edges), plus, len(subs), len(src["end"]), len(src["hash"])))
+        edges += node_edges
+        subs += src["end"] + src["hash"]
+    return nodes, edges, subs, levels
+
+
+def _emit_topic_index(var, prefix, topics):
+    """Emit the compiled topic index as const (flash) tables and hand them to the component."""
+    nodes, edges, subs, levels = _compile_topic_index(topics)
+    node_type = "esphome::espnow_pubsub::TopicIndex::Node"
+    edge_type = "esphome::espnow_pubsub::TopicIndex::Edge"
+    nodes_name = f"{prefix}_topic_nodes"
+    cg.add_global(
+        cg.RawStatement(
+            f"static const {node_type} {nodes_name}[] = {{"
+            + ", ".join("{" + ", ".join(str(v) for v in n) + "}" for n in nodes)
+            + "};"
+        )
+    )
+    edges_name = "nullptr"
+    if edges:
+        edges_name = f"{prefix}_topic_edges"
+        cg.add_global(
+            cg.RawStatement(
+                f"static const {edge_type} {edges_name}[] = {{"
+                + ", ".join(f"{{0x{h:08X}U, {off}, {length}, {child}}}" for h, off, length, child in edges)
+                + "};"
             )
+        )
+    subs_name = "nullptr"
+    if subs:
+        subs_name = f"{prefix}_topic_subs"
+        cg.add_global(
+            cg.RawStatement(f"static const uint16_t {subs_name}[] = {{{', '.join(str(i) for i in subs)}}};")
+        )
+    cg.add(
+        var.set_topic_index(
+            cg.RawExpression(nodes_name),
+            len(nodes),
+            cg.RawExpression(edges_name),
+            cg.RawExpression(subs_name),
+            cg.RawExpression(cpp_string_escape(levels)),
+            len(topics),
+        )
+    )
 
 # Sensor and text_sensor platform registration and codegen have been moved to sensor.py and text_sensor.py
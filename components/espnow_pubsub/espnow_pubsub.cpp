@@ -21,9 +21,13 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <iterator>
 #include <esp_rom_sys.h>
 #include "espnow_pubsub.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 #include "esphome/components/espnow/espnow_component.h"
 #include "esphome/components/espnow/espnow_packet.h"
@@ -33,64 +37,269 @@ namespace espnow_pubsub {
 
 static const char *const TAG = "espnow_pubsub";
 
+// Requests for the same unknown alias are repeated at most this often (ms)
+static const uint32_t ALIAS_REQUEST_INTERVAL = 1000;
+// At most ALIAS_REQUEST_BURST requests back to back, then one per ALIAS_REQUEST_REFILL ms
+static const uint32_t ALIAS_REQUEST_BURST = 4;
+static const uint32_t ALIAS_REQUEST_REFILL = 250;
+// Delay before answering alias requests, so requests from several receivers share one reply (ms)
+static const uint32_t ALIAS_REPLY_DELAY = 50;
+
+// Status text sensor values, indexed by StatusCode
+static const char *const STATUS_TEXT[] = {
+    "OK",
+    "RX error: null/empty data",
+    "RX error: message too short",
+    "RX error: malformed message",
+    "RX warning: receive ring full",
+    "RX warning: queue full",
+    "TX error: send failed",
+    "TX error: message too large",
+};
+static_assert(sizeof(STATUS_TEXT) / sizeof(STATUS_TEXT[0]) == STATUS_CODE_COUNT, "STATUS_TEXT out of sync");
+
 // Global callback context for send callbacks
 // Using a simple atomic counter instead of std::function to avoid issues
 static std::atomic<uint32_t> g_send_success_count{0};
 static std::atomic<uint32_t> g_send_fail_count{0};
 
-// MQTT-style topic matching with wildcards.
-// This function checks if a given topic string matches a subscription pattern using MQTT wildcards:
-//   - '#' matches all remaining topic levels (must be last token)
-//   - '+' matches any single topic level
-//
-// Example matches:
-//   sub = "foo/bar/#", topic = "foo/bar/baz/qux"   => true
-//   sub = "foo/+/baz", topic = "foo/x/baz"          => true
-//   sub = "foo/+/baz", topic = "foo/x/y/baz"        => false
-//   sub = "foo/#", topic = "foo"                     => true
-//   sub = "foo/#", topic = "foo/bar"                 => true
-//   sub = "foo/bar", topic = "foo/bar"               => true
-//   sub = "foo/bar", topic = "foo/bar/baz"           => false
-//
-// Called from receive_message() for every incoming message to determine if a subscription matches.
-bool mqtt_topic_matches(const std::string &sub, const std::string &topic) {
-  size_t sub_pos = 0, topic_pos = 0;
-  // Iterate through both sub and topic, token by token (split by '/')
-  while (sub_pos < sub.size() && topic_pos < topic.size()) {
-    // Find next '/' in both sub and topic
-    size_t sub_next = sub.find('/', sub_pos);
-    size_t topic_next = topic.find('/', topic_pos);
-    // Extract current token for sub and topic
-    std::string sub_token = sub.substr(sub_pos, sub_next == std::string::npos ? sub.size() - sub_pos : sub_next - sub_pos);
-    std::string topic_token = topic.substr(topic_pos, topic_next == std::string::npos ? topic.size() - topic_pos : topic_next - topic_pos);
-
-    if (sub_token == "#") {
-      // '#' matches all remaining topic levels, but must be last token in sub
-      // If '#' is not the last token, it's not a valid match (strict MQTT semantics)
-      return (sub_next == std::string::npos);
-    } else if (sub_token == "+") {
-      // '+' matches any single topic level, so continue to next token
-    } else if (sub_token != topic_token) {
-      // Tokens do not match and no wildcard, so not a match
-      return false;
+uint64_t pack_mac(const uint8_t *mac) {
+  uint64_t key = 0;
+  for (int i = 0; i < 6; i++) key = (key << 8) | mac[i];
+  return key;
+}
+
+// MessageInfo
+std::string MessageInfo::mac_str() const { return format_mac_address_pretty(src_addr); }
+
+// SequenceWindow
+bool SequenceWindow::check_and_update(uint32_t seq) {
+  // Signed distance from the newest sequence; correct across 32-bit wraparound
+  int32_t ahead = static_cast<int32_t>(seq - highest);
+  if (ahead > 0) {
+    bitmap = static_cast<uint32_t>(ahead) >= WINDOW_SIZE ? 0 : bitmap << ahead;
+    bitmap |= 1;
+    highest = seq;
+    return true;
+  }
+  uint32_t behind = highest - seq;
+  if (behind < WINDOW_SIZE) {
+    uint64_t bit = 1ULL << behind;
+    if (bitmap & bit) return false;
+    bitmap |= bit;
+    return true;
+  }
+  // Left of the window: too old to tell apart from a replay
+  return false;
+}
+
+// PeerTable
+// 64-bit finalizer (splitmix64) so MACs from the same vendor prefix spread across the table
+size_t PeerTable::hash_(uint64_t mac) {
+  mac ^= mac >> 30;
+  mac *= 0xbf58476d1ce4e5b9ULL;
+  mac ^= mac >> 27;
+  mac *= 0x94d049bb133111ebULL;
+  mac ^= mac >> 31;
+  return static_cast<size_t>(mac);
+}
+
+void PeerTable::init(size_t capacity, uint32_t max_age) {
+  size_t slots = 1;
+  while (slots < capacity * 2) slots <<= 1;
+  entries_.assign(slots, Entry{});
+  mask_ = slots - 1;
+  capacity_ = capacity;
+  size_ = 0;
+  max_age_ = max_age;
+}
+
+// probe_(): Index of the slot holding key, or of the first free slot in its probe sequence.
+// Always terminates because the table is never more than half full.
+size_t PeerTable::probe_(uint64_t key) const {
+  size_t idx = hash_(key & ~OCCUPIED) & mask_;
+  while (entries_[idx].key != 0 && entries_[idx].key != key) idx = (idx + 1) & mask_;
+  return idx;
+}
+
+PeerTable::Entry *PeerTable::find_or_insert(uint64_t mac, uint32_t now, bool &inserted) {
+  const uint64_t key = mac | OCCUPIED;
+  Entry *entry = &entries_[probe_(key)];
+  if (entry->key == key) {
+    // A sender that has been silent for too long starts over (e.g. it rebooted)
+    inserted = max_age_ != 0 && now - entry->last_seen > max_age_;
+    if (inserted) entry->last_seen = now;
+    return entry;
+  }
+  if (size_ >= capacity_) {
+    evict_oldest_(now);
+    entry = &entries_[probe_(key)];
+  }
+  entry->key = key;
+  entry->last_seen = now;
+  size_++;
+  inserted = true;
+  return entry;
+}
+
+// evict_oldest_(): Remove the least recently seen sender
+void PeerTable::evict_oldest_(uint32_t now) {
+  size_t oldest = 0;
+  uint32_t oldest_age = 0;
+  bool found = false;
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i].key == 0) continue;
+    uint32_t age = now - entries_[i].last_seen;
+    if (!found || age > oldest_age) {
+      oldest = i;
+      oldest_age = age;
+      found = true;
+    }
+  }
+  if (!found) return;
+  erase_(oldest);
+  evictions_++;
+}
+
+// erase_(): Backward-shift deletion, so no tombstones are needed
+void PeerTable::erase_(size_t idx) {
+  size_t hole = idx;
+  for (size_t next = (idx + 1) & mask_; entries_[next].key != 0; next = (next + 1) & mask_) {
+    size_t home = hash_(entries_[next].key & ~OCCUPIED) & mask_;
+    // Move the entry back only if the hole lies between its home slot and its current slot
+    if (((next - home) & mask_) >= ((next - hole) & mask_)) {
+      entries_[hole] = entries_[next];
+      hole = next;
     }
-    // Advance to next token in both sub and topic
-    sub_pos = (sub_next == std::string::npos) ? sub.size() : sub_next + 1;
-    topic_pos = (topic_next == std::string::npos) ? topic.size() : topic_next + 1;
   }
-  // Allow trailing '#' in sub to match any remaining topic levels (including zero levels)
-  if (sub_pos < sub.size() && sub.substr(sub_pos) == "#") return true;
-  // Only match if both sub and topic are fully consumed
-  return sub_pos == sub.size() && topic_pos == topic.size();
+  entries_[hole].key = 0;
+  size_--;
+}
+
+// MatchCache
+void MatchCache::init(size_t size, size_t subscription_count) {
+  size_t slots = 0;
+  if (size > 0) {
+    slots = 1;
+    while (slots < size) slots <<= 1;
+  }
+  words_ = (subscription_count + 31) / 32;
+  entries_.assign(slots, Entry{});
+  masks_.assign(slots * words_, 0);
+}
+
+bool MatchCache::lookup(std::string_view topic, uint32_t hash, std::vector<uint16_t> &out, bool count_stats) {
+  if (entries_.empty()) return false;
+  const size_t slot = hash & (entries_.size() - 1);
+  const Entry &entry = entries_[slot];
+  if (!entry.valid || entry.hash != hash || std::string_view(entry.topic, entry.topic_len) != topic) {
+    if (count_stats) misses_++;
+    return false;
+  }
+  if (count_stats) hits_++;
+  out.clear();
+  const uint32_t *mask = &masks_[slot * words_];
+  for (size_t w = 0; w < words_; w++) {
+    for (uint32_t bits = mask[w]; bits != 0; bits &= bits - 1) {
+      out.push_back(w * 32 + __builtin_ctz(bits));
+    }
+  }
+  return true;
+}
+
+void MatchCache::store(std::string_view topic, uint32_t hash, const std::vector<uint16_t> &ids) {
+  if (entries_.empty() || topic.size() > MAX_TOPIC_LEN) return;
+  const size_t slot = hash & (entries_.size() - 1);
+  Entry &entry = entries_[slot];
+  entry.hash = hash;
+  entry.valid = true;
+  entry.topic_len = topic.size();
+  memcpy(entry.topic, topic.data(), topic.size());
+  uint32_t *mask = &masks_[slot * words_];
+  std::fill(mask, mask + words_, 0);
+  for (uint16_t id : ids) mask[id / 32] |= 1UL << (id % 32);
+}
+
+void MatchCache::clear() {
+  for (auto &entry : entries_) entry.valid = false;
+}
+
+// AliasCache
+AliasCache::Entry *AliasCache::find_(uint64_t mac, uint16_t alias) {
+  for (auto &entry : entries_) {
+    if (entry.mac == mac && entry.alias == alias) return &entry;
+  }
+  return nullptr;
+}
+
+void AliasCache::bind(uint64_t mac, uint16_t alias, std::string_view topic, uint32_t now) {
+  if (capacity_ == 0) return;
+  Entry *entry = find_(mac, alias);
+  if (entry == nullptr) {
+    if (entries_.size() < capacity_) {
+      entries_.push_back({mac, alias, now, {}});
+      entry = &entries_.back();
+    } else {
+      // Replace the least recently used binding
+      entry = &*std::min_element(entries_.begin(), entries_.end(), [now](const Entry &a, const Entry &b) {
+        return now - a.last_used > now - b.last_used;
+      });
+      entry->mac = mac;
+      entry->alias = alias;
+    }
+  }
+  entry->last_used = now;
+  entry->topic.assign(topic.data(), topic.size());
+}
+
+const std::string *AliasCache::lookup(uint64_t mac, uint16_t alias, uint32_t now) {
+  Entry *entry = find_(mac, alias);
+  if (entry == nullptr) return nullptr;
+  entry->last_used = now;
+  return &entry->topic;
+}
+
+void AliasCache::forget(uint64_t mac) {
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(), [mac](const Entry &e) { return e.mac == mac; }),
+                 entries_.end());
 }
 
 // Constructor
 EspNowPubSub::EspNowPubSub() : Component() {
+  lanes_[PRIORITY_HIGH].size = 4;
+  lanes_[PRIORITY_NORMAL].size = MAX_QUEUE_SIZE;
+  lanes_[PRIORITY_LOW].size = 8;
   ESP_LOGV(TAG, "Creating ESP-NOW PubSub component...");
 }
 
 // setup(): Register with native espnow component
 void EspNowPubSub::setup() {
+  // Preallocate all receive storage so the steady-state path never touches the heap
+  peers_.init(peer_capacity_, peer_timeout_);
+  // Sort before build_index_() resolves the aliases
+  std::sort(aliases_.begin(), aliases_.end(),
+            [](const TopicAlias &a, const TopicAlias &b) { return a.alias < b.alias; });
+  // Also builds the prefilter, which must happen before the receive handler is registered
+  build_index_(!active_changed_);
+  alias_cache_.init(alias_cache_size_);
+  alias_request_tokens_ = ALIAS_REQUEST_BURST;
+  alias_request_refill_ = millis();
+  dynamic_aliases_.reserve(dynamic_alias_max_);
+  get_mac_address_raw(own_mac_);
+  if (dynamic_alias_max_ > 0 && announce_interval_ > 0) {
+    // Periodically re-announce our bindings for receivers that missed them
+    set_interval("alias_announce", announce_interval_, [this]() {
+      std::vector<uint16_t> aliases(dynamic_aliases_.size());
+      for (size_t i = 0; i < aliases.size(); i++) aliases[i] = i;
+      announce_aliases_(aliases);
+    });
+  }
+  // Random starting sequence and boot epoch, so receivers see a rebooted publisher as restarted
+  // instead of replaying old sequence numbers
+  seq_counter_ = random_uint32();
+  epoch_ = random_uint32();
+  setup_done_ = true;
+
   ESP_LOGV(TAG, "Registering with native espnow component");
 
   // Enable auto peer addition for broadcast sending
@@ -99,163 +308,630 @@ void EspNowPubSub::setup() {
   // Register for receiving broadcasts
   espnow::global_esp_now->register_broadcasted_handler(this);
 
-  last_status_ = "OK";
-#ifdef USE_TEXT_SENSOR
-  if (status_text_sensor_) status_text_sensor_->publish_state(last_status_);
-#endif
+  set_status_(STATUS_OK);
 }
 
-// on_broadcasted(): Called by native espnow component when a broadcast is received
+// build_index_(): Rebuild everything derived from the active subscriptions: topic index, match cache,
+// alias matches, lanes and prefilter. Runs in setup() and between dispatches after changes.
+void EspNowPubSub::build_index_(bool use_compiled) {
+  // Subscription ids are positions, so keeping subscriptions_ in dispatch order makes every match list
+  // (sorted by id) come out in dispatch order too. Codegen already adds them sorted.
+  auto by_order = [](const Subscription &a, const Subscription &b) { return a.options.order < b.options.order; };
+  if (!std::is_sorted(subscriptions_.begin(), subscriptions_.end(), by_order)) {
+    std::stable_sort(subscriptions_.begin(), subscriptions_.end(), by_order);
+    use_compiled = false;
+  }
+  // The compiled index is only valid for exactly the subscriptions codegen saw
+  // Subscriptions without wildcards go into the exact topic table, the rest into the topic trie.
+  if (!use_compiled || !index_.is_loaded() || compiled_subscription_count_ != subscriptions_.size()) {
+    index_ = TopicIndex();
+    for (size_t i = 0; i < subscriptions_.size(); i++) {
+      if (subscriptions_[i].active && subscriptions_[i].wildcard) index_.add(subscriptions_[i].topic, i);
+    }
+    index_.finalize();
+  }
+  exact_index_ = ExactTopicIndex();
+  wildcard_count_ = 0;
+  for (size_t i = 0; i < subscriptions_.size(); i++) {
+    if (!subscriptions_[i].active) continue;
+    if (subscriptions_[i].wildcard) {
+      wildcard_count_++;
+    } else {
+      exact_index_.add(subscriptions_[i].topic, i);
+    }
+  }
+  exact_index_.finalize();
+  matches_.reserve(subscriptions_.size());
+  exact_matches_.reserve(subscriptions_.size());
+  wildcard_matches_.reserve(subscriptions_.size());
+  captures_.reserve(subscriptions_.size());
+  match_cache_.init(match_cache_size_, subscriptions_.size());
+
+  // Only lanes that some subscription uses get a slab; without subscriptions everything is normal.
+  // Slabs are never released, messages may still be queued in them.
+  for (const auto &sub : subscriptions_) lanes_[sub.options.priority].used = true;
+  if (subscriptions_.empty()) lanes_[PRIORITY_NORMAL].used = true;
+  lanes_used_ = 0;
+  for (auto &lane : lanes_) {
+    if (!lane.used) continue;
+    if (lane.slab.empty()) lane.slab.resize(lane.size);
+    lanes_used_++;
+  }
+
+  // Resolve the subscriptions of every aliased topic once, so aliased frames skip matching
+  for (auto &alias : aliases_) {
+    collect_matches_(alias.topic, alias.hash, alias.matches, CACHE_BYPASS);
+    alias.priority = PRIORITY_COUNT;
+    for (uint16_t id : alias.matches) {
+      alias.priority = std::min(alias.priority, subscriptions_[id].options.priority);
+    }
+  }
+
+  build_prefilter_();
+}
+
+// on_broadcasted(): Called by native espnow component when a broadcast is received.
+// Only copies the raw frame into rx_ring_; parsing, dedup and dispatch happen in loop().
 bool EspNowPubSub::on_broadcasted(const espnow::ESPNowRecvInfo &info,
                                   const uint8_t *data, uint8_t size) {
-  ESP_LOGV(TAG, "[ON_BCAST] Received broadcast, size=%d", size);
-  if (data == nullptr || size == 0) {
-    ESP_LOGE(TAG, "[ON_BCAST] data is null or empty");
-    last_status_ = "RX error: null/empty data";
-#ifdef USE_TEXT_SENSOR
-    if (status_text_sensor_) status_text_sensor_->publish_state(last_status_);
-#endif
+  if (!prefilter_accepts_(data, size)) {
+    filtered_count_.fetch_add(1, std::memory_order_relaxed);
+    mark_status_dirty_();
     return false;
   }
 
-  if (size <= sizeof(uint32_t)) {
-    ESP_LOGE(TAG, "[ON_BCAST] Message too short: %d bytes", size);
-    last_status_ = "RX error: message too short";
-#ifdef USE_TEXT_SENSOR
-    if (status_text_sensor_) status_text_sensor_->publish_state(last_status_);
-#endif
+  uint32_t head = rx_head_.load(std::memory_order_relaxed);
+  uint32_t tail = rx_tail_.load(std::memory_order_acquire);
+  if (head - tail >= RX_RING_SIZE) {
+    rx_overrun_count_.fetch_add(1, std::memory_order_relaxed);
+    enable_loop_soon_any_context();
     return false;
   }
 
-  // Parse seq + topic\0payload
+  RxFrame &frame = rx_ring_[head & (RX_RING_SIZE - 1)];
+  memcpy(frame.src_addr, info.src_addr, sizeof(frame.src_addr));
+  frame.rssi = info.rx_ctrl ? info.rx_ctrl->rssi : 0;
+  frame.channel = info.rx_ctrl ? info.rx_ctrl->channel : 0;
+  frame.rx_timestamp = info.rx_ctrl ? info.rx_ctrl->timestamp : 0;
+  frame.timestamp = millis();
+  // Null/empty frames are queued with size 0 so loop() can report them
+  frame.size = data == nullptr ? 0 : std::min<size_t>(size, sizeof(frame.data));
+  if (frame.size > 0) memcpy(frame.data, data, frame.size);
+  rx_head_.store(head + 1, std::memory_order_release);
+
+  // Wake up the loop to process the frame
+  enable_loop_soon_any_context();
+  return false;  // Don't stop propagation
+}
+
+// build_prefilter_(): Collect the first topic level of every active subscription and publish it
+// as the new prefilter snapshot. A subscription starting with a wildcard level disables the prefilter.
+void EspNowPubSub::build_prefilter_() {
+  auto filter = std::make_unique<Prefilter>();
+  for (const auto &sub : subscriptions_) {
+    if (!sub.active) continue;
+    size_t level_len = std::min(sub.topic.find('/'), sub.topic.size());
+    std::string first_level = sub.topic.substr(0, level_len);
+    if (first_level == "+" || first_level == "#") {
+      filter->pass_all = true;
+      filter->hashes.clear();
+      break;
+    }
+    filter->hashes.push_back(topic_hash(first_level.data(), first_level.size()));
+  }
+  std::sort(filter->hashes.begin(), filter->hashes.end());
+  filter->hashes.erase(std::unique(filter->hashes.begin(), filter->hashes.end()), filter->hashes.end());
+
+  if (prefilter_current_) prefilter_retired_.push_back(std::move(prefilter_current_));
+  prefilter_current_ = std::move(filter);
+  prefilter_.store(prefilter_current_.get(), std::memory_order_seq_cst);
+  reclaim_prefilters_();
+}
+
+// reclaim_prefilters_(): Free retired prefilter snapshots once no receive-context reader is in
+// progress. A reader that registers after the check loads the pointer after the store above (both
+// are sequentially consistent), so it can only see the current snapshot.
+void EspNowPubSub::reclaim_prefilters_() {
+  if (prefilter_retired_.empty() || prefilter_readers_.load(std::memory_order_seq_cst) != 0) return;
+  prefilter_retired_.clear();
+}
+
+// prefilter_accepts_(): Cheap receive-context check that a frame's first topic level could match
+// a subscription. Frames too short to carry a topic and typed frames (empty topic) are accepted
+// so loop() can handle them.
+bool EspNowPubSub::prefilter_accepts_(const uint8_t *data, uint8_t size) const {
+  if (data == nullptr || size <= FRAME_HEADER_LEN) return true;
+  const char *topic = reinterpret_cast<const char *>(data + FRAME_HEADER_LEN);
+  if (topic[0] == '\0') return true;
+  const size_t remaining = size - FRAME_HEADER_LEN;
+  size_t level_len = 0;
+  while (level_len < remaining && topic[level_len] != '/' && topic[level_len] != '\0') level_len++;
+  const uint32_t hash = topic_hash(topic, level_len);
+
+  prefilter_readers_.fetch_add(1, std::memory_order_seq_cst);
+  const Prefilter *filter = prefilter_.load(std::memory_order_seq_cst);
+  bool accepted = filter == nullptr || filter->pass_all ||
+                  std::binary_search(filter->hashes.begin(), filter->hashes.end(), hash);
+  prefilter_readers_.fetch_sub(1, std::memory_order_release);
+  return accepted;
+}
+
+// drain_rx_ring_(): Move all pending raw frames from rx_ring_ into the message queue
+void EspNowPubSub::drain_rx_ring_() {
+  uint32_t overruns = rx_overrun_count_.exchange(0, std::memory_order_relaxed);
+  if (overruns > 0) {
+    ESP_LOGW(TAG, "[RX] Receive ring full, dropped %u frame(s)", overruns);
+    set_status_(STATUS_RX_RING_FULL);
+  }
+
+  uint32_t tail = rx_tail_.load(std::memory_order_relaxed);
+  uint32_t head = rx_head_.load(std::memory_order_acquire);
+  while (tail != head) {
+    process_frame_(rx_ring_[tail & (RX_RING_SIZE - 1)]);
+    tail++;
+    // Release the slot back to the producer only after we're done reading it
+    rx_tail_.store(tail, std::memory_order_release);
+  }
+}
+
+// process_frame_(): Parse, deduplicate and queue a raw frame
+void EspNowPubSub::process_frame_(const RxFrame &frame) {
+  const uint8_t *data = frame.data;
+  uint8_t size = frame.size;
+  ESP_LOGV(TAG, "[RX] Processing frame, size=%d", size);
+  if (size == 0) {
+    ESP_LOGE(TAG, "[RX] data is null or empty");
+    set_status_(STATUS_RX_EMPTY);
+    return;
+  }
+
+  if (size <= FRAME_HEADER_LEN) {
+    ESP_LOGE(TAG, "[RX] Message too short: %d bytes", size);
+    set_status_(STATUS_RX_TOO_SHORT);
+    return;
+  }
+
+  // Parse seq + epoch + topic\0payload
   uint32_t seq = 0;
   memcpy(&seq, data, sizeof(uint32_t));
-  const char *raw = reinterpret_cast<const char *>(data + sizeof(uint32_t));
-  size_t remaining = size - sizeof(uint32_t);
+  uint16_t epoch = 0;
+  memcpy(&epoch, data + sizeof(uint32_t), sizeof(uint16_t));
+  const char *raw = reinterpret_cast<const char *>(data + FRAME_HEADER_LEN);
+  size_t remaining = size - FRAME_HEADER_LEN;
 
+  // The topic must be NUL-terminated; the payload after it may be empty
   size_t topic_len = strnlen(raw, remaining);
-  if (topic_len >= remaining - 1) {
-    ESP_LOGE(TAG, "[ON_BCAST] Malformed message: topic_len=%zu, remaining=%zu", topic_len, remaining);
-    last_status_ = "RX error: malformed message";
-#ifdef USE_TEXT_SENSOR
-    if (status_text_sensor_) status_text_sensor_->publish_state(last_status_);
-#endif
-    return false;
+  if (topic_len >= remaining) {
+    ESP_LOGE(TAG, "[RX] Malformed message: topic_len=%zu, remaining=%zu", topic_len, remaining);
+    set_status_(STATUS_RX_MALFORMED);
+    return;
   }
 
-  std::string topic(raw, topic_len);
-  std::string payload(raw + topic_len + 1, remaining - topic_len - 1);
-
-  // Build MAC key for deduplication
-  char mac_str[18];
-  snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-           info.src_addr[0], info.src_addr[1], info.src_addr[2],
-           info.src_addr[3], info.src_addr[4], info.src_addr[5]);
-  std::string mac_key(mac_str);
+  size_t payload_len = remaining - topic_len - 1;
 
   // Deduplication check
-  auto it = last_sequence_by_mac_.find(mac_key);
-  if (it != last_sequence_by_mac_.end()) {
-    uint32_t last_seq = it->second;
-    if (seq == last_seq) {
-      ESP_LOGV(TAG, "[ON_BCAST] Duplicate seq %u from %s ignored", seq, mac_str);
-      return false;
+  uint64_t mac_key = pack_mac(frame.src_addr);
+  bool inserted = false;
+  PeerTable::Entry *peer = peers_.find_or_insert(mac_key, frame.timestamp, inserted);
+  bool restarted = inserted || peer->epoch != epoch;
+  if (!restarted && !peer->window.check_and_update(seq)) {
+    if (!peer->window.is_left_of(seq)) {
+      ESP_LOGV(TAG, "[RX] Duplicate seq %u from %012llX ignored", seq, (unsigned long long) mac_key);
+      return;
     }
-    if (seq < last_seq) {
-      ESP_LOGV(TAG, "[ON_BCAST] Sequence reset from %u to %u for %s", last_seq, seq, mac_str);
+    // Normally a late replay, but a sender that rebooted into the same epoch with a lower
+    // sequence looks the same; only a run of them is taken as a restart
+    if (++peer->left_run < PeerTable::RESYNC_AFTER) {
+      ESP_LOGV(TAG, "[RX] Old seq %u from %012llX ignored", seq, (unsigned long long) mac_key);
+      return;
     }
-    it->second = seq;
-  } else {
-    last_sequence_by_mac_[mac_key] = seq;
+    restarted = true;
   }
+  if (restarted) {
+    if (!inserted) ESP_LOGD(TAG, "[RX] Sender %012llX restarted", (unsigned long long) mac_key);
+    peer->window.reset(seq);
+    peer->epoch = epoch;
+    // Its alias numbers may now mean other topics; relearn them from BIND frames and announcements
+    alias_cache_.forget(mac_key);
+  }
+  peer->left_run = 0;
+  peer->last_seen = frame.timestamp;
 
-  ESP_LOGV(TAG, "[ON_BCAST] Queuing topic='%s', payload='%s', seq=%u", topic.c_str(), payload.c_str(), seq);
+  // Update RSSI and received count
+  last_rssi_.store(frame.rssi, std::memory_order_relaxed);
+  received_count_.fetch_add(1, std::memory_order_relaxed);
+  set_status_(STATUS_OK);
 
-  // Queue overflow handling
-  if (message_queue_.size() >= MAX_QUEUE_SIZE) {
-    ESP_LOGW(TAG, "[ON_BCAST] Message queue full, dropping oldest");
-    last_status_ = "RX warning: queue full";
-#ifdef USE_TEXT_SENSOR
-    if (status_text_sensor_) status_text_sensor_->publish_state(last_status_);
-#endif
-    message_queue_.erase(message_queue_.begin());
+  std::string_view topic(raw, topic_len);
+  std::string_view payload(raw + topic_len + 1, payload_len);
+  const TopicAlias *alias = nullptr;
+  if (topic_len == 0 && !handle_typed_frame_(frame, topic, payload, alias)) return;
+  if (alias == nullptr && topic.size() + payload.size() > MAX_MESSAGE_SIZE) {
+    ESP_LOGE(TAG, "[RX] Message too large: topic %zu + payload %zu bytes", topic.size(), payload.size());
+    set_status_(STATUS_RX_MALFORMED);
+    return;
   }
-  message_queue_.push_back({topic, payload, seq});
 
-  // Update RSSI and received count
-#ifdef USE_SENSOR
-  if (info.rx_ctrl) {
-    last_rssi_ = info.rx_ctrl->rssi;
+  ESP_LOGV(TAG, "[RX] Queuing topic='%.*s', payload='%.*s', seq=%u", (int) topic.size(), topic.data(),
+           (int) payload.size(), payload.data(), seq);
+
+  MessageLane *lane = select_lane_(topic, alias);
+  if (lane == nullptr) {
+    ESP_LOGV(TAG, "[RX] No subscription matches topic '%.*s'", (int) topic.size(), topic.data());
+    filtered_count_.fetch_add(1, std::memory_order_relaxed);
+    return;
   }
-#endif
-  received_count_++;
-  last_status_ = "OK";
+  QueuedMessage *msg = queue_push_(*lane, topic);
+  if (msg == nullptr) return;
+  msg->sequence = seq;
+  memcpy(msg->info.src_addr, frame.src_addr, sizeof(msg->info.src_addr));
+  msg->info.rssi = frame.rssi;
+  msg->info.channel = frame.channel;
+  msg->info.rx_timestamp = frame.rx_timestamp;
+  msg->info.received_at = frame.timestamp;
+  // Aliased topics are dispatched from the alias table; only the payload goes into the slot
+  msg->alias = alias != nullptr ? alias - aliases_.data() : NO_ALIAS;
+  msg->topic_len = alias != nullptr ? 0 : topic.size();
+  msg->payload_len = payload.size();
+  memcpy(msg->data, topic.data(), msg->topic_len);
+  memcpy(msg->data + msg->topic_len, payload.data(), payload.size());
+}
 
-  // Wake up the loop to process the message
-  enable_loop_soon_any_context();
-  return false;  // Don't stop propagation
+// handle_typed_frame_(): Handle a frame with an empty topic. Alias control frames are consumed here;
+// for aliased messages topic (and alias, for static aliases) is resolved and payload trimmed to the
+// message payload. Returns false if there is no message to queue.
+bool EspNowPubSub::handle_typed_frame_(const RxFrame &frame, std::string_view &topic, std::string_view &payload,
+                                       const TopicAlias *&alias) {
+  if (payload.empty()) {
+    ESP_LOGE(TAG, "[RX] Malformed frame: missing type");
+    set_status_(STATUS_RX_MALFORMED);
+    return false;
+  }
+  const uint8_t type = payload[0];
+  payload.remove_prefix(1);
+  const uint64_t mac = pack_mac(frame.src_addr);
+  uint16_t id;
+  switch (type) {
+    case FRAME_ALIAS:
+      if (payload.size() < sizeof(uint16_t)) break;
+      memcpy(&id, payload.data(), sizeof(uint16_t));
+      payload.remove_prefix(sizeof(uint16_t));
+      alias = find_alias_(id);
+      if (alias == nullptr) {
+        ESP_LOGD(TAG, "[RX] Unknown topic alias %u", id);
+        filtered_count_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      topic = alias->topic;
+      return true;
+
+    case FRAME_DYNAMIC_ALIAS: {
+      if (payload.size() < sizeof(uint16_t)) break;
+      memcpy(&id, payload.data(), sizeof(uint16_t));
+      payload.remove_prefix(sizeof(uint16_t));
+      const std::string *bound = alias_cache_.lookup(mac, id, frame.timestamp);
+      if (bound == nullptr) {
+        alias_miss_count_++;
+        if (alias_cache_.capacity() == 0) {
+          // Can't learn bindings, so every aliased frame of this sender is lost; say so once
+          if (!alias_cache_warned_) ESP_LOGW(TAG, "[RX] Dropping dynamic-alias frames: alias_cache_size is 0");
+          alias_cache_warned_ = true;
+        } else {
+          ESP_LOGD(TAG, "[RX] Unknown alias %u from %012llX", id, (unsigned long long) mac);
+        }
+        filtered_count_.fetch_add(1, std::memory_order_relaxed);
+        request_alias_(frame.src_addr, id);
+        return false;
+      }
+      topic = *bound;
+      return true;
+    }
+
+    case FRAME_ALIAS_BIND: {
+      if (payload.size() < sizeof(uint16_t)) break;
+      memcpy(&id, payload.data(), sizeof(uint16_t));
+      payload.remove_prefix(sizeof(uint16_t));
+      size_t len = strnlen(payload.data(), payload.size());
+      if (len == 0 || len >= payload.size()) break;  // topic must be NUL-terminated, payload may be empty
+      topic = payload.substr(0, len);
+      payload.remove_prefix(len + 1);
+      alias_cache_.bind(mac, id, topic, frame.timestamp);
+      return true;
+    }
+
+    case FRAME_ALIAS_ANNOUNCE:
+      while (payload.size() > sizeof(uint16_t)) {
+        memcpy(&id, payload.data(), sizeof(uint16_t));
+        size_t len = strnlen(payload.data() + sizeof(uint16_t), payload.size() - sizeof(uint16_t));
+        if (len == 0 || len >= payload.size() - sizeof(uint16_t)) break;
+        alias_cache_.bind(mac, id, payload.substr(sizeof(uint16_t), len), frame.timestamp);
+        payload.remove_prefix(sizeof(uint16_t) + len + 1);
+      }
+      ESP_LOGV(TAG, "[RX] Alias announcement from %012llX", (unsigned long long) mac);
+      if (payload.empty()) return false;
+      break;
+
+    case FRAME_ALIAS_REQUEST:
+      if (payload.size() < ESP_NOW_ETH_ALEN + sizeof(uint16_t)) break;
+      if (memcmp(payload.data(), own_mac_, ESP_NOW_ETH_ALEN) != 0) return false;
+      memcpy(&id, payload.data() + ESP_NOW_ETH_ALEN, sizeof(uint16_t));
+      if (id < dynamic_aliases_.size() &&
+          std::find(alias_replies_.begin(), alias_replies_.end(), id) == alias_replies_.end()) {
+        // Answer all requests arriving within a short window with one announcement
+        if (alias_replies_.empty()) {
+          set_timeout("alias_reply", ALIAS_REPLY_DELAY, [this]() {
+            announce_aliases_(alias_replies_);
+            alias_replies_.clear();
+          });
+        }
+        alias_replies_.push_back(id);
+      }
+      return false;
+
+    default:
+      break;
+  }
+  ESP_LOGE(TAG, "[RX] Malformed frame: type=0x%02X, %zu byte(s)", type, payload.size());
+  set_status_(STATUS_RX_MALFORMED);
+  return false;
+}
+
+// select_lane_(): Pick the queue for a message: the highest priority of any matching subscription.
+// With a single lane in use no matching is needed; aliased topics use the priority resolved in
+// setup(). Returns nullptr if nothing matches.
+EspNowPubSub::MessageLane *EspNowPubSub::select_lane_(std::string_view topic, const TopicAlias *alias) {
+  if (alias != nullptr) return alias->priority == PRIORITY_COUNT ? nullptr : &lanes_[alias->priority];
+  if (lanes_used_ == 1) {
+    for (auto &lane : lanes_) {
+      if (lane.used) return &lane;
+    }
+  }
+  // Dispatch matches the topic again, so only that lookup counts towards the cache statistics
+  size_t best = PRIORITY_COUNT;
+  match_topic_(topic, matches_, CACHE_UNCOUNTED);
+  for (uint16_t id : matches_) {
+    best = std::min<size_t>(best, subscriptions_[id].options.priority);
+  }
+  return best == PRIORITY_COUNT ? nullptr : &lanes_[best];
+}
+
+// next_lane_(): Highest priority lane with a pending message, or nullptr if all are empty
+EspNowPubSub::MessageLane *EspNowPubSub::next_lane_() {
+  for (auto &lane : lanes_) {
+    if (lane.count > 0) return &lane;
+  }
+  return nullptr;
+}
+
+// queue_push_(): Claim a slot in lane for a message on topic, applying overflow_policy_.
+// Returns nullptr if the message must be dropped.
+EspNowPubSub::QueuedMessage *EspNowPubSub::queue_push_(MessageLane &lane, std::string_view topic) {
+  if (overflow_policy_ == OVERFLOW_COALESCE) {
+    // Newest payload replaces a queued message on the same topic, keeping its place in the queue
+    for (size_t i = 0; i < lane.count; i++) {
+      QueuedMessage &queued = lane.at(i);
+      if (topic_of_(queued) == topic) {
+        ESP_LOGV(TAG, "[RX] Coalescing message on topic '%.*s'", (int) topic.size(), topic.data());
+        return &queued;
+      }
+    }
+  }
+
+  if (lane.count >= lane.size) {
+    set_status_(STATUS_RX_QUEUE_FULL);
+    if (overflow_policy_ == OVERFLOW_DROP_NEWEST) {
+      ESP_LOGW(TAG, "[RX] Message queue full, dropping newest");
+      return nullptr;
+    }
+    ESP_LOGW(TAG, "[RX] Message queue full, dropping oldest");
+    lane.pop();
+  }
+  QueuedMessage *msg = &lane.at(lane.count);
+  lane.count++;
+  return msg;
 }
 
 // loop(): Process queued messages
 void EspNowPubSub::loop() {
-  static bool pending_sensor_update = false;
-
-  // Process queued messages
-  if (!message_queue_.empty()) {
-    std::vector<QueuedMessage> local_queue;
-    local_queue.swap(message_queue_);
-    for (const auto &msg : local_queue) {
-      ESP_LOGD(TAG, "[LOOP] Processing: topic='%s', payload='%s', seq=%u", msg.topic.c_str(), msg.payload.c_str(), msg.sequence);
-      receive_message(msg.topic, msg.payload, msg.sequence);
+  apply_subscription_changes_();
+  reclaim_prefilters_();
+
+  // Parse raw frames handed over by on_broadcasted()
+  drain_rx_ring_();
+
+  // Process queued messages, highest priority lane first, within the dispatch budget;
+  // whatever is left carries over to the next loop
+  MessageLane *lane = next_lane_();
+  if (lane != nullptr) {
+    const uint32_t start = millis();
+    size_t dispatched = 0;
+    for (; lane != nullptr; lane = next_lane_()) {
+      // Always make progress on at least one message per loop
+      if (dispatched > 0 && ((dispatch_max_messages_ != 0 && dispatched >= dispatch_max_messages_) ||
+                             (dispatch_budget_ != 0 && millis() - start >= dispatch_budget_))) {
+        budget_exceeded_count_++;
+        ESP_LOGV(TAG, "[LOOP] Dispatch budget reached after %zu message(s), rest carried over", dispatched);
+        break;
+      }
+      // Dispatch views straight into the slot; it is released only afterwards
+      const QueuedMessage &msg = lane->at(0);
+      std::string_view topic = topic_of_(msg);
+      std::string_view payload(msg.data + msg.topic_len, msg.payload_len);
+      MessageInfo info = msg.info;
+      info.age = millis() - info.received_at;
+      ESP_LOGD(TAG, "[LOOP] Processing: topic='%.*s', payload='%.*s', seq=%u, age=%u ms", (int) topic.size(),
+               topic.data(), (int) payload.size(), payload.data(), msg.sequence, info.age);
+      if (msg.alias != NO_ALIAS) {
+        // Matches were resolved in advance, so captures come from the wildcard levels
+        dispatch_(topic, payload, msg.sequence, info, aliases_[msg.alias].matches, {});
+      } else {
+        receive_message(topic, payload, msg.sequence, info);
+      }
+      lane->pop();
+      dispatched++;
+      // Subscription changes made by the callbacks apply from the next message on
+      apply_subscription_changes_();
     }
-    pending_sensor_update = true;
-    return;
   }
 
-  // Publish sensor updates
-  if (pending_sensor_update) {
+  // Publish status and sensors at most once per status_interval_
+  bool status_pending = flush_status_();
+
+  // Idle - disable loop
+  if (next_lane_() == nullptr && !status_pending && !subscriptions_changed_) disable_loop();
+}
+
+// set_status_(): Record the current status; safe from any context, published later by flush_status_().
+// Errors are counted and latched until published; STATUS_OK only refreshes the sensors.
+void EspNowPubSub::set_status_(StatusCode code) {
+  if (code != STATUS_OK) {
+    status_counts_[code].fetch_add(1, std::memory_order_relaxed);
+    status_code_.store(code, std::memory_order_relaxed);
+  }
+  mark_status_dirty_();
+}
+
+// mark_status_dirty_(): Request a sensor refresh; safe from any context
+void EspNowPubSub::mark_status_dirty_() {
+  if (!status_dirty_.exchange(true, std::memory_order_acq_rel)) enable_loop_soon_any_context();
+}
+
+// flush_status_(): Publish the status text and sensors if anything changed and status_interval_ has passed.
+// Returns true while an update is still pending.
+bool EspNowPubSub::flush_status_() {
+  if (!status_dirty_.load(std::memory_order_acquire)) return false;
+  const uint32_t now = millis();
+  if (status_published_ && now - last_status_publish_ < status_interval_) return true;
+  status_dirty_.store(false, std::memory_order_release);
+  status_published_ = true;
+  last_status_publish_ = now;
+
 #ifdef USE_SENSOR
-    if (rssi_sensor_) rssi_sensor_->publish_state(last_rssi_);
-    if (received_count_sensor_) received_count_sensor_->publish_state(received_count_);
+  if (rssi_sensor_) rssi_sensor_->publish_state(last_rssi_.load(std::memory_order_relaxed));
+  if (sent_count_sensor_) sent_count_sensor_->publish_state(sent_count_.load(std::memory_order_relaxed));
+  if (received_count_sensor_) received_count_sensor_->publish_state(received_count_.load(std::memory_order_relaxed));
+  if (peer_evictions_sensor_) peer_evictions_sensor_->publish_state(peers_.evictions());
+  if (budget_exceeded_sensor_) budget_exceeded_sensor_->publish_state(budget_exceeded_count_);
+  if (filtered_count_sensor_) filtered_count_sensor_->publish_state(filtered_count_.load(std::memory_order_relaxed));
+  if (stale_count_sensor_) stale_count_sensor_->publish_state(stale_count_);
+  if (alias_miss_count_sensor_) alias_miss_count_sensor_->publish_state(alias_miss_count_);
+  if (match_cache_hits_sensor_) match_cache_hits_sensor_->publish_state(match_cache_.hits());
+  if (match_cache_misses_sensor_) match_cache_misses_sensor_->publish_state(match_cache_.misses());
+  if (exact_dispatch_sensor_) exact_dispatch_sensor_->publish_state(exact_dispatch_count_);
+  if (wildcard_dispatch_sensor_) wildcard_dispatch_sensor_->publish_state(wildcard_dispatch_count_);
+  for (size_t code = 0; code < STATUS_CODE_COUNT; code++) {
+    if (status_count_sensors_[code]) {
+      status_count_sensors_[code]->publish_state(status_counts_[code].load(std::memory_order_relaxed));
+    }
+  }
 #endif
+  // Clear the latched error unless a newer one arrived meanwhile; the next update then reports OK
+  // unless another error occurs
+  uint8_t latched = status_code_.load(std::memory_order_relaxed);
+  const StatusCode code = static_cast<StatusCode>(latched);
+  if (code != STATUS_OK) {
+    status_code_.compare_exchange_strong(latched, STATUS_OK, std::memory_order_relaxed);
+    status_dirty_.store(true, std::memory_order_release);
+  }
 #ifdef USE_TEXT_SENSOR
-    if (status_text_sensor_) status_text_sensor_->publish_state(last_status_);
-#endif
-    pending_sensor_update = false;
-    return;
+  if (status_text_sensor_ && code != published_status_code_) {
+    status_text_sensor_->publish_state(STATUS_TEXT[code]);
+    published_status_code_ = code;
   }
-
-  // Idle - disable loop
-  disable_loop();
+#endif
+  return code != STATUS_OK;
 }
 
 // publish(): Send a broadcast message with send_times
-// Uses native component's send queue
 void EspNowPubSub::publish(const std::string &topic, const std::string &payload) {
   ESP_LOGI(TAG, "Publishing: topic='%s', payload='%s'", topic.c_str(), payload.c_str());
+  send_message_(topic, reinterpret_cast<const uint8_t *>(payload.data()), payload.size());
+}
+
+// publish(): Send a raw byte payload; the wire format is binary-safe end to end
+void EspNowPubSub::publish(const std::string &topic, const uint8_t *data, size_t size) {
+  ESP_LOGI(TAG, "Publishing: topic='%s', %zu byte binary payload", topic.c_str(), size);
+  send_message_(topic, data, size);
+}
+
+// Append [\0][type][alias:uint16] to a frame
+static void append_alias_header(std::vector<uint8_t> &frame, FrameType type, uint16_t alias) {
+  frame.push_back('\0');
+  frame.push_back(type);
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&alias);
+  frame.insert(frame.end(), bytes, bytes + sizeof(uint16_t));
+}
+
+// send_message_(): Build a message frame and send it
+// Topics with a static alias go as FRAME_ALIAS and, with dynamic aliases enabled, other topics as
+// FRAME_ALIAS_BIND on first use and FRAME_DYNAMIC_ALIAS after that. Everything else is sent as
+// [seq:uint32][epoch:uint16][topic\0][payload].
+void EspNowPubSub::send_message_(const std::string &topic, const uint8_t *payload, size_t payload_len) {
+  if (topic.empty()) {
+    // An empty topic marks a typed frame on the wire
+    ESP_LOGE(TAG, "Cannot publish on an empty topic");
+    set_status_(STATUS_TX_FAILED);
+    return;
+  }
+  const TopicAlias *alias = find_alias_(topic);
+  // Except for static aliases, receivers queue the full topic, so the plain frame must fit
+  const size_t plain_len = FRAME_HEADER_LEN + topic.size() + 1 + payload_len;
+  const size_t alias_len = FRAME_HEADER_LEN + 2 + sizeof(uint16_t) + payload_len;
+  if ((alias != nullptr ? alias_len : plain_len) > ESP_NOW_MAX_DATA_LEN) {
+    ESP_LOGE(TAG, "Message too large: topic %zu + payload %zu bytes exceeds %d byte frame",
+             alias != nullptr ? 2 + sizeof(uint16_t) : topic.size() + 1, payload_len, ESP_NOW_MAX_DATA_LEN);
+    set_status_(STATUS_TX_TOO_LARGE);
+    return;
+  }
 
-  // Build message: [seq:uint32][topic\0][payload]
-  static uint32_t seq_counter = 0;
-  uint32_t seq = seq_counter++;
+  std::vector<uint8_t> msg = begin_frame_();
+  bool created = false;
+  uint16_t dynamic = alias != nullptr ? NO_ALIAS : dynamic_alias_(topic, created);
+  if (alias != nullptr) {
+    append_alias_header(msg, FRAME_ALIAS, alias->alias);
+  } else if (dynamic != NO_ALIAS && !created) {
+    append_alias_header(msg, FRAME_DYNAMIC_ALIAS, dynamic);
+  } else if (dynamic != NO_ALIAS && plain_len + 2 + sizeof(uint16_t) <= ESP_NOW_MAX_DATA_LEN) {
+    // First message on a new alias carries the binding
+    append_alias_header(msg, FRAME_ALIAS_BIND, dynamic);
+    msg.insert(msg.end(), topic.begin(), topic.end());
+    msg.push_back('\0');
+  } else {
+    // No alias, or no room for the binding (receivers learn it from the next announcement)
+    msg.insert(msg.end(), topic.begin(), topic.end());
+    msg.push_back('\0');
+  }
+  msg.insert(msg.end(), payload, payload + payload_len);
+  send_frame_(msg);
+}
 
-  std::vector<uint8_t> msg;
-  msg.resize(sizeof(uint32_t));
-  memcpy(&msg[0], &seq, sizeof(uint32_t));
-  msg.insert(msg.end(), topic.begin(), topic.end());
-  msg.push_back('\0');
-  msg.insert(msg.end(), payload.begin(), payload.end());
+// begin_frame_(): Start a frame with the header: next sequence number and our boot epoch
+std::vector<uint8_t> EspNowPubSub::begin_frame_() {
+  uint32_t seq = seq_counter_++;
+  std::vector<uint8_t> frame;
+  frame.reserve(ESP_NOW_MAX_DATA_LEN);
+  frame.resize(FRAME_HEADER_LEN);
+  memcpy(&frame[0], &seq, sizeof(uint32_t));
+  memcpy(&frame[sizeof(uint32_t)], &epoch_, sizeof(uint16_t));
+  return frame;
+}
 
+// send_frame_(): Queue a frame send_times_ times
+// Uses native component's send queue
+void EspNowPubSub::send_frame_(const std::vector<uint8_t> &frame) {
   // Queue sends with the native component (with callback to avoid crash)
+  bool failed = false;
   for (int i = 0; i < send_times_; i++) {
     esp_err_t err = espnow::global_esp_now->send(
-        espnow::ESPNOW_BROADCAST_ADDR, msg,
+        espnow::ESPNOW_BROADCAST_ADDR, frame,
         [](esp_err_t err) {});
 
     if (err == ESP_OK) {
-      sent_count_++;
+      sent_count_.fetch_add(1, std::memory_order_relaxed);
       ESP_LOGV(TAG, "Queued send (attempt %d)", i + 1);
     } else {
       ESP_LOGW(TAG, "Queue send failed on attempt %d: %d", i + 1, err);
+      failed = true;
     }
 
     // Small delay between queue attempts
@@ -264,99 +940,438 @@ void EspNowPubSub::publish(const std::string &topic, const std::string &payload)
     }
   }
 
-#ifdef USE_SENSOR
-  if (sent_count_sensor_) sent_count_sensor_->publish_state(sent_count_);
-#endif
+  set_status_(failed ? STATUS_TX_FAILED : STATUS_OK);
+}
 
-  last_status_ = "OK";
-#ifdef USE_TEXT_SENSOR
-  if (status_text_sensor_) status_text_sensor_->publish_state(last_status_);
-#endif
+// dynamic_alias_(): Our dynamic alias for topic, assigning the next free one (created is set).
+// Returns NO_ALIAS if dynamic aliases are disabled or all are in use.
+uint16_t EspNowPubSub::dynamic_alias_(const std::string &topic, bool &created) {
+  uint32_t hash = topic_hash(topic.data(), topic.size());
+  for (size_t i = 0; i < dynamic_aliases_.size(); i++) {
+    if (dynamic_aliases_[i].hash == hash && dynamic_aliases_[i].topic == topic) return i;
+  }
+  if (dynamic_aliases_.size() >= dynamic_alias_max_) return NO_ALIAS;
+  dynamic_aliases_.push_back({topic, hash});
+  created = true;
+  ESP_LOGD(TAG, "Bound alias %zu to topic '%s'", dynamic_aliases_.size() - 1, topic.c_str());
+  return dynamic_aliases_.size() - 1;
+}
+
+// announce_aliases_(): Broadcast our bindings for aliases, packed into as few frames as possible
+void EspNowPubSub::announce_aliases_(const std::vector<uint16_t> &aliases) {
+  static constexpr size_t HEADER_LEN = FRAME_HEADER_LEN + 2;
+  std::vector<uint8_t> frame;
+  for (uint16_t id : aliases) {
+    const std::string &topic = dynamic_aliases_[id].topic;
+    const size_t entry_len = sizeof(uint16_t) + topic.size() + 1;
+    if (HEADER_LEN + entry_len > ESP_NOW_MAX_DATA_LEN) continue;  // only ever sent as a plain topic
+    if (!frame.empty() && frame.size() + entry_len > ESP_NOW_MAX_DATA_LEN) {
+      send_frame_(frame);
+      frame.clear();
+    }
+    if (frame.empty()) {
+      frame = begin_frame_();
+      frame.push_back('\0');
+      frame.push_back(FRAME_ALIAS_ANNOUNCE);
+    }
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&id);
+    frame.insert(frame.end(), bytes, bytes + sizeof(uint16_t));
+    frame.insert(frame.end(), topic.begin(), topic.end());
+    frame.push_back('\0');
+  }
+  if (!frame.empty()) send_frame_(frame);
+}
+
+// request_alias_(): Ask sender mac to announce its binding for alias, at most once per
+// ALIAS_REQUEST_INTERVAL for the same alias and within the global request budget
+void EspNowPubSub::request_alias_(const uint8_t *mac, uint16_t alias) {
+  if (alias_cache_.capacity() == 0) return;
+  const uint64_t key = (pack_mac(mac) << 16) | alias;
+  const uint32_t now = millis();
+  for (const auto &request : alias_requests_) {
+    if (request.key == key && now - request.time < ALIAS_REQUEST_INTERVAL) return;
+  }
+  // Refill the bucket for the time elapsed
+  const uint32_t refill = (now - alias_request_refill_) / ALIAS_REQUEST_REFILL;
+  if (refill > 0) {
+    alias_request_tokens_ = std::min(ALIAS_REQUEST_BURST, alias_request_tokens_ + refill);
+    // A full bucket restarts the refill clock, otherwise the partial interval carries over
+    if (alias_request_tokens_ == ALIAS_REQUEST_BURST) {
+      alias_request_refill_ = now;
+    } else {
+      alias_request_refill_ += refill * ALIAS_REQUEST_REFILL;
+    }
+  }
+  if (alias_request_tokens_ == 0) {
+    ESP_LOGV(TAG, "[RX] Alias request budget exhausted, not requesting alias %u", alias);
+    return;
+  }
+  alias_request_tokens_--;
+  alias_requests_[alias_request_next_] = {key, now};
+  alias_request_next_ = (alias_request_next_ + 1) % alias_requests_.size();
+
+  std::vector<uint8_t> frame = begin_frame_();
+  frame.push_back('\0');
+  frame.push_back(FRAME_ALIAS_REQUEST);
+  frame.insert(frame.end(), mac, mac + ESP_NOW_ETH_ALEN);
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&alias);
+  frame.insert(frame.end(), bytes, bytes + sizeof(uint16_t));
+  send_frame_(frame);
 }
 
 // receive_message(): Match topic and trigger callbacks
-void EspNowPubSub::receive_message(const std::string &topic, const std::string &payload, uint32_t sequence) {
+void EspNowPubSub::receive_message(std::string_view topic, std::string_view payload, uint32_t sequence,
+                                   const MessageInfo &info) {
+  // Take the scratch buffer so a callback that re-enters receive_message() can't overwrite it
+  std::vector<uint16_t> matches;
+  std::vector<TopicCaptures> captures;
+  matches.swap(matches_);
+  captures.swap(captures_);
+  match_topic_(topic, matches, CACHE_COUNTED, &captures);
+  dispatch_(topic, payload, sequence, info, matches, captures);
+  captures.swap(captures_);
+  matches.swap(matches_);
+}
+
+// match_topic_(): Matching subscription ids for topic, in subscription order
+void EspNowPubSub::match_topic_(std::string_view topic, std::vector<uint16_t> &out, CacheUse cache_use,
+                                std::vector<TopicCaptures> *captures) {
+  collect_matches_(topic, topic_hash(topic.data(), topic.size()), out, cache_use, captures);
+}
+
+// collect_matches_(): One hash lookup for the exact subscriptions; the wildcard ones come from the
+// match cache or the topic index, which is only walked if there are wildcard subscriptions at all
+void EspNowPubSub::collect_matches_(std::string_view topic, uint32_t hash, std::vector<uint16_t> &out,
+                                    CacheUse cache_use, std::vector<TopicCaptures> *captures) {
+  exact_index_.match(topic, hash, exact_matches_);
+  wildcard_matches_.clear();
+  if (captures != nullptr) captures->clear();
+  const bool use_cache = cache_use != CACHE_BYPASS;
+  if (wildcard_count_ > 0 &&
+      !(use_cache && match_cache_.lookup(topic, hash, wildcard_matches_, cache_use == CACHE_COUNTED))) {
+    index_.match(topic, wildcard_matches_, captures);
+    if (cache_use == CACHE_COUNTED) match_cache_.store(topic, hash, wildcard_matches_);
+  }
+  // Both are sorted; out has capacity for all subscriptions, so this doesn't allocate
+  out.clear();
+  std::merge(exact_matches_.begin(), exact_matches_.end(), wildcard_matches_.begin(), wildcard_matches_.end(),
+             std::back_inserter(out));
+}
+
+// dispatch_(): Trigger the callbacks of the matching subscriptions, in subscription (dispatch) order,
+// until an exclusive subscription fires or, in first_match mode, any one does
+void EspNowPubSub::dispatch_(std::string_view topic, std::string_view payload, uint32_t sequence,
+                             const MessageInfo &info, const std::vector<uint16_t> &matches,
+                             const std::vector<TopicCaptures> &captures) {
   bool matched = false;
-  for (const auto &sub : subscriptions_) {
-    if (mqtt_topic_matches(sub.topic, topic)) {
-      ESP_LOGI(TAG, "Matched topic '%s' with subscription '%s', payload='%s'",
-               topic.c_str(), sub.topic.c_str(), payload.c_str());
-      matched = true;
-      sub.callback(topic, payload, sequence);
+  bool stale = false;
+  size_t wildcard_index = 0;  // captures follows the order of the wildcard subscriptions in matches
+  for (uint16_t id : matches) {
+    auto &sub = subscriptions_[id];
+    const size_t capture_index = sub.wildcard ? wildcard_index++ : 0;
+    if (!sub.active) continue;  // the indexes only hold active subscriptions; don't rely on it
+    if (sub.options.max_age != 0 && info.age > sub.options.max_age) {
+      ESP_LOGD(TAG, "Discarding stale message on '%.*s' for subscription '%s' (age %u ms > %u ms)",
+               (int) topic.size(), topic.data(), sub.topic.c_str(), info.age, sub.options.max_age);
+      stale = true;
+      continue;
+    }
+    if (sub.options.filter.checks != 0 && !filter_accepts_(sub, payload)) {
+      ESP_LOGV(TAG, "Payload on '%.*s' rejected by the filter of subscription '%s'", (int) topic.size(), topic.data(),
+               sub.topic.c_str());
+      matched = true;  // matched, just not wanted
+      continue;
+    }
+    ESP_LOGI(TAG, "Matched topic '%.*s' with subscription '%s', payload='%.*s'", (int) topic.size(),
+             topic.data(), sub.topic.c_str(), (int) payload.size(), payload.data());
+    matched = true;
+    // Recorded by the trie walk; after a match cache hit, taken from the subscription's wildcard levels
+    TopicCaptures sub_captures{topic};
+    if (sub.wildcard) {
+      sub_captures = capture_index < captures.size() ? captures[capture_index] : sub.capture_levels.extract(topic);
+      wildcard_dispatch_count_++;
+    } else {
+      exact_dispatch_count_++;
     }
+    sub.callback(topic, payload, sequence, info, sub_captures);
+    if (sub.options.exclusive || dispatch_mode_ == DISPATCH_FIRST_MATCH) {
+      ESP_LOGV(TAG, "Subscription '%s' ends dispatch of '%.*s'", sub.topic.c_str(), (int) topic.size(), topic.data());
+      break;
+    }
+  }
+  if (stale) stale_count_++;
+  if (!matched && !stale) {
+    ESP_LOGD(TAG, "No subscription matched topic '%.*s'", (int) topic.size(), topic.data());
+  }
+}
+
+// filter_accepts_(): Evaluate the payload filter of a subscription
+bool EspNowPubSub::filter_accepts_(Subscription &sub, std::string_view payload) {
+  const PayloadFilter &filter = sub.options.filter;
+  if ((filter.checks & PayloadFilter::CHECK_EQUALS) && payload != filter.equals) return false;
+  if ((filter.checks & PayloadFilter::CHECK_PREFIX) && payload.substr(0, filter.prefix.size()) != filter.prefix) {
+    return false;
+  }
+  if (filter.checks & PayloadFilter::CHECK_RANGE) {
+    // strtof() needs a terminated string; anything longer than this isn't a plain number anyway
+    char number[32];
+    if (payload.empty() || payload.size() >= sizeof(number)) return false;
+    memcpy(number, payload.data(), payload.size());
+    number[payload.size()] = '\0';
+    char *end;
+    float value = strtof(number, &end);
+    if (end != number + payload.size() || std::isnan(value)) return false;
+    if (value < filter.min || value > filter.max) return false;
+  }
+  if (filter.checks & PayloadFilter::CHECK_CHANGED) {
+    if (sub.has_last_payload && payload == sub.last_payload) return false;
+    // Capacity is reserved when the subscription is added, so this doesn't allocate
+    sub.last_payload.assign(payload.data(), payload.size());
+    sub.has_last_payload = true;
   }
-  if (!matched) {
-    ESP_LOGD(TAG, "No subscription matched topic '%s'", topic.c_str());
+  return true;
+}
+
+// add_topic_alias(): Register a static topic alias
+void EspNowPubSub::add_topic_alias(const std::string &topic, uint16_t alias) {
+  aliases_.push_back({alias, topic, topic_hash(topic.data(), topic.size()), {}, PRIORITY_COUNT});
+  ESP_LOGV(TAG, "Added topic alias %u for topic: %s", alias, topic.c_str());
+}
+
+// find_alias_(): Look up a topic alias by number (receive side)
+const EspNowPubSub::TopicAlias *EspNowPubSub::find_alias_(uint16_t alias) const {
+  auto it = std::lower_bound(aliases_.begin(), aliases_.end(), alias,
+                             [](const TopicAlias &a, uint16_t id) { return a.alias < id; });
+  return it != aliases_.end() && it->alias == alias ? &*it : nullptr;
+}
+
+// find_alias_(): Look up a topic alias by topic (publish side)
+const EspNowPubSub::TopicAlias *EspNowPubSub::find_alias_(std::string_view topic) const {
+  uint32_t hash = topic_hash(topic.data(), topic.size());
+  for (const auto &alias : aliases_) {
+    if (alias.hash == hash && alias.topic == topic) return &alias;
   }
+  return nullptr;
 }
 
 // dump_config(): Log configuration
 void EspNowPubSub::dump_config() {
   ESP_LOGCONFIG(TAG, "ESP-NOW PubSub:");
   ESP_LOGCONFIG(TAG, "  Repeat transmissions: %d", send_times_);
-  ESP_LOGCONFIG(TAG, "  Subscriptions: %zu", subscriptions_.size());
+  static const char *const PRIORITY_NAMES[] = {"high", "normal", "low"};
+  for (size_t i = 0; i < PRIORITY_COUNT; i++) {
+    if (lanes_[i].used) ESP_LOGCONFIG(TAG, "  Queue size (%s priority): %zu", PRIORITY_NAMES[i], lanes_[i].size);
+  }
+  static const char *const OVERFLOW_POLICY_NAMES[] = {"drop oldest", "drop newest", "coalesce"};
+  ESP_LOGCONFIG(TAG, "  Overflow policy: %s", OVERFLOW_POLICY_NAMES[overflow_policy_]);
+  ESP_LOGCONFIG(TAG, "  Dispatch budget: %u ms, %zu message(s) per loop (0 = unlimited)", dispatch_budget_,
+                dispatch_max_messages_);
+  ESP_LOGCONFIG(TAG, "  Dispatch mode: %s", dispatch_mode_ == DISPATCH_FIRST_MATCH ? "first match" : "all");
+  ESP_LOGCONFIG(TAG, "  Status interval: %u ms", status_interval_);
+  ESP_LOGCONFIG(TAG, "  Peer table: %zu senders, timeout %u ms", peer_capacity_, peer_timeout_);
+  ESP_LOGCONFIG(TAG, "  Subscriptions: %zu (%zu exact topic(s), %zu wildcard; topic index: %zu nodes, %s)",
+                subscriptions_.size(), exact_index_.size(), wildcard_count_, index_.node_count(),
+                index_.is_loaded() ? "compiled" : "built at setup");
+  const Prefilter *filter = prefilter_.load(std::memory_order_acquire);
+  if (filter == nullptr || filter->pass_all) {
+    ESP_LOGCONFIG(TAG, "  Prefilter: disabled (wildcard first level)");
+  } else {
+    ESP_LOGCONFIG(TAG, "  Prefilter: %zu first-level topic(s)", filter->hashes.size());
+  }
+  ESP_LOGCONFIG(TAG, "  Match cache: %zu entries", match_cache_.size());
+  if (!aliases_.empty()) ESP_LOGCONFIG(TAG, "  Topic aliases: %zu", aliases_.size());
+  if (dynamic_alias_max_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Dynamic aliases: up to %zu topic(s), announced every %u ms", dynamic_alias_max_,
+                  announce_interval_);
+  }
+  ESP_LOGCONFIG(TAG, "  Alias cache: %zu binding(s)", alias_cache_.capacity());
   for (const auto &sub : subscriptions_) {
-    ESP_LOGCONFIG(TAG, "    - %s", sub.topic.c_str());
+    ESP_LOGCONFIG(TAG, "    - %s (%s priority, max age %u ms, order %d%s%s)", sub.topic.c_str(),
+                  PRIORITY_NAMES[sub.options.priority], sub.options.max_age, sub.options.order,
+                  sub.options.exclusive ? ", exclusive" : "", sub.active ? "" : ", unsubscribed");
   }
 
 #ifdef USE_SENSOR
   if (rssi_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: RSSI configured");
   if (sent_count_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Sent Count configured");
   if (received_count_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Received Count configured");
+  if (peer_evictions_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Peer Evictions configured");
+  if (budget_exceeded_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Budget Exceeded configured");
+  if (filtered_count_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Filtered Count configured");
+  if (stale_count_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Stale Count configured");
+  if (alias_miss_count_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Alias Miss Count configured");
+  if (match_cache_hits_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Match Cache Hits configured");
+  if (match_cache_misses_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Match Cache Misses configured");
+  if (exact_dispatch_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Exact Dispatch Count configured");
+  if (wildcard_dispatch_sensor_) ESP_LOGCONFIG(TAG, "  Sensor: Wildcard Dispatch Count configured");
 #endif
 #ifdef USE_TEXT_SENSOR
   if (status_text_sensor_) ESP_LOGCONFIG(TAG, "  Text Sensor: Status configured");
 #endif
 }
 
-// add_subscription(): Register a topic subscription
-void EspNowPubSub::add_subscription(const std::string &topic, OnMessageTrigger *trigger) {
-  subscriptions_.push_back({topic,
-                            [trigger](const std::string &t, const std::string &p, uint32_t s) {
-                              trigger->trigger(t, p, s);
-                            }});
+// add_subscription(): Register a declared topic subscription
+// on_message triggers get owned copies of topic and payload, materialized per matching subscription.
+// These are the only heap allocations on the dispatch path; on_view_message avoids them
+void EspNowPubSub::add_subscription(const std::string &topic, OnMessageTrigger *trigger,
+                                    const SubscriptionOptions &options) {
+  trigger->set_handle(add_subscription_(
+      topic,
+      [trigger](std::string_view t, std::string_view p, uint32_t s, const MessageInfo &i, const TopicCaptures &c) {
+        trigger->trigger(std::string(t), std::string(p), s, i, OwnedTopicCaptures(c));
+      },
+      options, false));
   ESP_LOGV(TAG, "Added subscription for topic: %s", topic.c_str());
 }
 
-// OnMessageTrigger
-OnMessageTrigger::OnMessageTrigger(EspNowPubSub *parent, const std::string &topic) {}
-
-// EspnowPubSubPublishAction
-template<typename... Ts>
-EspnowPubSubPublishAction<Ts...>::EspnowPubSubPublishAction(EspNowPubSub *parent) : parent_(parent) {}
+// on_view_message triggers get views straight into the queue slot, no copies
+void EspNowPubSub::add_subscription(const std::string &topic, OnViewMessageTrigger *trigger,
+                                    const SubscriptionOptions &options) {
+  trigger->set_handle(add_subscription_(
+      topic,
+      [trigger](std::string_view t, std::string_view p, uint32_t s, const MessageInfo &i, const TopicCaptures &c) {
+        trigger->trigger(t, p, s, i, c);
+      },
+      options, false));
+  ESP_LOGV(TAG, "Added view subscription for topic: %s", topic.c_str());
+}
 
-template<typename... Ts>
-void EspnowPubSubPublishAction<Ts...>::set_topic(TemplatableValue<std::string, Ts...> topic) {
-  topic_ = std::move(topic);
+// on_binary_message triggers get a pointer/length view of the raw payload bytes
+void EspNowPubSub::add_subscription(const std::string &topic, OnBinaryMessageTrigger *trigger,
+                                    const SubscriptionOptions &options) {
+  trigger->set_handle(add_subscription_(
+      topic,
+      [trigger](std::string_view t, std::string_view p, uint32_t s, const MessageInfo &i, const TopicCaptures &c) {
+        trigger->trigger(t, reinterpret_cast<const uint8_t *>(p.data()), p.size(), s, i, c);
+      },
+      options, false));
+  ESP_LOGV(TAG, "Added binary subscription for topic: %s", topic.c_str());
 }
 
-template<typename... Ts>
-void EspnowPubSubPublishAction<Ts...>::set_payload(TemplatableValue<std::string, Ts...> payload) {
-  payload_ = std::move(payload);
+// subscribe(): Add a runtime subscription
+uint32_t EspNowPubSub::subscribe(const std::string &pattern, MessageCallback callback,
+                                 const SubscriptionOptions &options) {
+  SubscriptionOptions runtime_options = options;
+  runtime_options.subscribed = true;
+  uint32_t handle = add_subscription_(pattern, std::move(callback), runtime_options, true);
+  ESP_LOGD(TAG, "Subscribed to '%s' (handle %u)", pattern.c_str(), handle);
+  return handle;
 }
 
-template<typename... Ts>
-void EspnowPubSubPublishAction<Ts...>::play(const Ts&... x) {
-  auto topic = this->topic_.value(x...);
-  auto payload = this->payload_.value(x...);
-  auto *parent = parent_;
-  if (parent != nullptr) {
-    parent->publish(topic, payload);
+// add_subscription_(): Add a subscription directly before setup(), staged afterwards
+uint32_t EspNowPubSub::add_subscription_(const std::string &topic, MessageCallback callback,
+                                         const SubscriptionOptions &options, bool runtime) {
+  uint32_t handle = next_handle_++;
+  bool wildcard = topic.find_first_of("+#") != std::string::npos;
+  Subscription sub{topic, std::move(callback), options, handle, options.subscribed, runtime, wildcard,
+                   wildcard ? CaptureLevels::of(topic) : CaptureLevels{}, {}, false};
+  if (options.filter.checks & PayloadFilter::CHECK_CHANGED) sub.last_payload.reserve(MAX_MESSAGE_SIZE);
+  if (!setup_done_) {
+    subscriptions_.push_back(std::move(sub));
   } else {
-    ESP_LOGE(TAG, "Parent is null, cannot publish");
+    pending_additions_.push_back(std::move(sub));
+    subscriptions_changed_ = true;
+    enable_loop();
+  }
+  return handle;
+}
+
+// unsubscribe(): Remove a runtime subscription or pause a declared one
+bool EspNowPubSub::unsubscribe(uint32_t handle) {
+  // Not applied yet: just drop it
+  for (auto it = pending_additions_.begin(); it != pending_additions_.end(); ++it) {
+    if (it->handle == handle) {
+      pending_additions_.erase(it);
+      return true;
+    }
+  }
+  for (auto &sub : subscriptions_) {
+    if (sub.handle != handle) continue;
+    if (!setup_done_) {
+      // Before setup() there is no index yet; pause in place. The compiled index has the subscription,
+      // so setup() must build its own.
+      active_changed_ |= sub.active;
+      sub.active = false;
+      return true;
+    }
+    pending_states_.emplace_back(handle, false);
+    subscriptions_changed_ = true;
+    enable_loop();
+    ESP_LOGD(TAG, "Unsubscribing from '%s' (handle %u)", sub.topic.c_str(), handle);
+    return true;
+  }
+  return false;
+}
+
+// resubscribe(): Resume a paused declared subscription
+bool EspNowPubSub::resubscribe(uint32_t handle) {
+  for (auto &sub : subscriptions_) {
+    if (sub.handle != handle) continue;
+    if (!setup_done_) {
+      active_changed_ |= !sub.active;
+      sub.active = true;
+      return true;
+    }
+    pending_states_.emplace_back(handle, true);
+    subscriptions_changed_ = true;
+    enable_loop();
+    ESP_LOGD(TAG, "Resubscribing to '%s' (handle %u)", sub.topic.c_str(), handle);
+    return true;
+  }
+  return false;
+}
+
+// apply_subscription_changes_(): Apply the staged changes and rebuild the index. Only called
+// between dispatches, so no callback ever sees the table change under it.
+void EspNowPubSub::apply_subscription_changes_() {
+  if (!subscriptions_changed_) return;
+  subscriptions_changed_ = false;
+  for (const auto &change : pending_states_) {
+    auto it = std::find_if(subscriptions_.begin(), subscriptions_.end(),
+                           [&change](const Subscription &sub) { return sub.handle == change.first; });
+    if (it == subscriptions_.end()) continue;
+    if (change.second) {
+      it->active = true;
+    } else if (it->runtime) {
+      subscriptions_.erase(it);
+    } else {
+      it->active = false;
+    }
   }
+  pending_states_.clear();
+  for (auto &sub : pending_additions_) subscriptions_.push_back(std::move(sub));
+  pending_additions_.clear();
+  build_index_(false);
+  ESP_LOGD(TAG, "Subscription index rebuilt: %zu subscription(s), %zu nodes", subscriptions_.size(),
+           index_.node_count());
 }
 
-// Explicit template instantiations
-template class EspnowPubSubPublishAction<>;
-template class EspnowPubSubPublishAction<float>;
-template class EspnowPubSubPublishAction<std::string, std::string>;
-template class EspnowPubSubPublishAction<int>;
-template class EspnowPubSubPublishAction<bool>;
-template class EspnowPubSubPublishAction<float, std::string>;
-template class EspnowPubSubPublishAction<std::string, float>;
-template class EspnowPubSubPublishAction<int, std::string>;
-template class EspnowPubSubPublishAction<std::string, int>;
+// OwnedTopicCaptures
+OwnedTopicCaptures::OwnedTopicCaptures(const TopicCaptures &captures) {
+  size_t used = 0;
+  for (size_t i = 0; i < captures.size(); i++) {
+    const std::string_view capture = captures[i];
+    if (capture.size() > data_.size() - used) break;
+    std::memcpy(data_.data() + used, capture.data(), capture.size());
+    spans_[count_++] = {static_cast<uint16_t>(used), static_cast<uint16_t>(capture.size())};
+    used += capture.size();
+  }
+}
+
+std::string OwnedTopicCaptures::operator[](size_t i) const {
+  return i < count_ ? std::string(data_.data() + spans_[i].offset, spans_[i].length) : std::string();
+}
+
+// OnMessageTrigger
+OnMessageTrigger::OnMessageTrigger(EspNowPubSub *parent, const std::string &topic) : SubscriptionTrigger(parent) {}
+
+// OnViewMessageTrigger
+OnViewMessageTrigger::OnViewMessageTrigger(EspNowPubSub *parent, const std::string &topic)
+    : SubscriptionTrigger(parent) {}
+
+// OnBinaryMessageTrigger
+OnBinaryMessageTrigger::OnBinaryMessageTrigger(EspNowPubSub *parent, const std::string &topic)
+    : SubscriptionTrigger(parent) {}
 
 }  // namespace espnow_pubsub
 }  // namespace esphome
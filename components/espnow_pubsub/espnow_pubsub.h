@@ -30,25 +30,265 @@
 #include "esphome/components/text_sensor/text_sensor.h"
 #endif
 #include "esphome/components/espnow/espnow_component.h"
+#include "topic_index.h"
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <vector>
 #include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
-#include <unordered_map>
 
 namespace esphome {
 namespace espnow_pubsub {
 
-// Helper: MQTT topic match with wildcards
-// Supports + (single-level) and # (multi-level) wildcards
-bool mqtt_topic_matches(const std::string &sub, const std::string &topic);
+// Component status reported through the status text sensor (see STATUS_TEXT)
+enum StatusCode : uint8_t {
+  STATUS_OK = 0,
+  STATUS_RX_EMPTY,
+  STATUS_RX_TOO_SHORT,
+  STATUS_RX_MALFORMED,
+  STATUS_RX_RING_FULL,
+  STATUS_RX_QUEUE_FULL,
+  STATUS_TX_FAILED,
+  STATUS_TX_TOO_LARGE,
+  STATUS_CODE_COUNT,
+};
+
+// Every frame starts with [seq:uint32][epoch:uint16]: the sender's sequence number and a random
+// value it picks at boot, so receivers can tell a restarted sender from a replay.
+constexpr size_t FRAME_HEADER_LEN = sizeof(uint32_t) + sizeof(uint16_t);
+
+// Frames with an empty topic carry a frame type byte instead: [header][\0][type][...]
+enum FrameType : uint8_t {
+  FRAME_ALIAS = 0x01,  // [alias:uint16][payload]: message on a topic from the topic alias table
+  FRAME_DYNAMIC_ALIAS = 0x02,  // [alias:uint16][payload]: message on a topic the sender bound to alias
+  FRAME_ALIAS_BIND = 0x03,  // [alias:uint16][topic\0][payload]: message that also binds alias to topic
+  FRAME_ALIAS_ANNOUNCE = 0x04,  // ([alias:uint16][topic\0])*: the sender's bindings
+  FRAME_ALIAS_REQUEST = 0x05,  // [mac:6][alias:uint16]: asks sender mac to announce alias
+};
+
+// What to do with a received message when the queue is full
+enum OverflowPolicy : uint8_t {
+  OVERFLOW_DROP_OLDEST = 0,
+  OVERFLOW_DROP_NEWEST,
+  OVERFLOW_COALESCE,  // replace a queued message on the same topic, else drop oldest
+};
+
+// How many of the subscriptions matching a message are dispatched
+enum DispatchMode : uint8_t {
+  DISPATCH_ALL = 0,  // every match, except after an exclusive subscription fired
+  DISPATCH_FIRST_MATCH,  // only the first match that fires
+};
+
+// Priority class of a subscription; each class has its own reserved receive queue and
+// higher classes are always dispatched first
+enum MessagePriority : uint8_t {
+  PRIORITY_HIGH = 0,
+  PRIORITY_NORMAL,
+  PRIORITY_LOW,
+  PRIORITY_COUNT,
+};
+
+// Payload conditions of a subscription, checked before its trigger fires.
+// Every condition enabled in checks must hold.
+struct PayloadFilter {
+  enum Check : uint8_t {
+    CHECK_EQUALS = 1 << 0,   // payload == equals
+    CHECK_PREFIX = 1 << 1,   // payload starts with prefix
+    CHECK_RANGE = 1 << 2,    // payload is a number within [min, max]
+    CHECK_CHANGED = 1 << 3,  // payload differs from the last one delivered to the subscription
+  };
+
+  uint8_t checks{0};
+  std::string equals;
+  std::string prefix;
+  float min{-INFINITY};
+  float max{INFINITY};
+};
+
+// Per-subscription options, filled in by codegen
+struct SubscriptionOptions {
+  MessagePriority priority{PRIORITY_NORMAL};
+  uint32_t max_age{0};  // ms; older queued messages are discarded for this subscription (0 = no limit)
+  bool subscribed{true};  // initial state of a declared subscription, see EspNowPubSub::unsubscribe()
+  PayloadFilter filter;
+  int16_t order{0};  // matches are dispatched by ascending order, then in the order they were added
+  bool exclusive{false};  // once this subscription fired, the remaining matches are skipped
+};
+
+// Pack a 6-byte MAC address into the low 48 bits of an integer
+uint64_t pack_mac(const uint8_t *mac);
+
+// Receive metadata of a message, passed to subscription triggers as `info`
+struct MessageInfo {
+  uint8_t src_addr[ESP_NOW_ETH_ALEN];  // sender MAC
+  int8_t rssi;
+  uint8_t channel;
+  uint32_t rx_timestamp;  // radio timestamp of the frame (us)
+  uint32_t received_at;   // millis() when the frame was received
+  uint32_t age;           // ms the message waited in the queue before dispatch
+
+  uint64_t mac() const { return pack_mac(src_addr); }
+  // Sender MAC formatted as "AA:BB:CC:DD:EE:FF"
+  std::string mac_str() const;
+};
+
+// SequenceWindow: Per-sender anti-replay window (RFC 4303 style).
+// Tracks the highest sequence seen plus a bitmap of the WINDOW_SIZE sequences below it,
+// using serial-number arithmetic so the 32-bit counter may wrap.
+struct SequenceWindow {
+  static constexpr uint32_t WINDOW_SIZE = 64;
+
+  uint32_t highest;
+  uint64_t bitmap;  // bit n set: highest - n has been seen
+
+  void reset(uint32_t seq) {
+    highest = seq;
+    bitmap = 1;
+  }
+  // Returns true if seq has not been seen before and records it. Sequences left of the window
+  // are rejected; a restarted sender is detected by its epoch instead (see PeerTable::Entry).
+  bool check_and_update(uint32_t seq);
+  // True if seq is older than the window, as opposed to a duplicate inside it
+  bool is_left_of(uint32_t seq) const {
+    return static_cast<int32_t>(seq - highest) <= 0 && highest - seq >= WINDOW_SIZE;
+  }
+};
+
+// PeerTable: Bounded open-addressing (linear probing) table of per-sender state keyed by packed MAC.
+// Slots are allocated once by init(); when full, the least recently seen sender is evicted.
+class PeerTable {
+ public:
+  struct Entry {
+    uint64_t key;  // packed MAC | OCCUPIED, 0 when the slot is free
+    SequenceWindow window;
+    uint32_t last_seen;  // millis() of the last accepted frame from this sender
+    uint16_t epoch;  // boot epoch of the sender's frames; a new one means it restarted
+    uint8_t left_run;  // consecutive frames left of the window, see RESYNC_AFTER
+  };
+  // A sender whose frames keep landing left of the window restarted with the same 16-bit epoch;
+  // after this many in a row its window is restarted from the current frame
+  static constexpr uint8_t RESYNC_AFTER = 8;
+
+  // Allocate room for capacity senders. Entries idle for longer than max_age ms are
+  // treated as new senders (0 disables aging).
+  void init(size_t capacity, uint32_t max_age);
+  // Returns the entry for mac, inserting a fresh one if absent or expired (inserted is set;
+  // the caller must then reset its window and epoch). Only a new entry gets last_seen = now; the
+  // caller refreshes it once the frame is accepted, so rejected frames don't keep a sender alive.
+  Entry *find_or_insert(uint64_t mac, uint32_t now, bool &inserted);
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  uint32_t evictions() const { return evictions_; }
+
+ protected:
+  static constexpr uint64_t OCCUPIED = 1ULL << 63;
+  static size_t hash_(uint64_t mac);
+  size_t probe_(uint64_t key) const;
+  void evict_oldest_(uint32_t now);
+  void erase_(size_t idx);
+
+  std::vector<Entry> entries_;  // power-of-two sized, at least twice capacity_
+  size_t mask_{0};
+  size_t capacity_{0};
+  size_t size_{0};
+  uint32_t max_age_{0};
+  uint32_t evictions_{0};
+};
 
-class OnMessageTrigger; // Forward declaration
+// MatchCache: Direct-mapped cache from a topic to the set of subscriptions matching it, stored as
+// a bitmask over subscription ids. Only topics up to MAX_TOPIC_LEN characters are cached; each entry
+// keeps its topic so hits are verified, not just trusted on the hash.
+class MatchCache {
+ public:
+  static constexpr size_t MAX_TOPIC_LEN = 64;
+
+  // Allocate size entries (rounded up to a power of two, 0 disables the cache) for
+  // subscription_count subscriptions
+  void init(size_t size, size_t subscription_count);
+  // On a hit, fills out with the matching subscription ids in ascending order. count_stats = false
+  // leaves hits() and misses() alone, for lookups that aren't a dispatch
+  bool lookup(std::string_view topic, uint32_t hash, std::vector<uint16_t> &out, bool count_stats = true);
+  void store(std::string_view topic, uint32_t hash, const std::vector<uint16_t> &ids);
+  // Drop all entries, e.g. when the subscriptions change
+  void clear();
+  size_t size() const { return entries_.size(); }
+  uint32_t hits() const { return hits_; }
+  uint32_t misses() const { return misses_; }
+
+ protected:
+  struct Entry {
+    uint32_t hash;
+    bool valid;
+    uint8_t topic_len;
+    char topic[MAX_TOPIC_LEN];
+  };
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> masks_;  // words_ words per entry
+  size_t words_{0};
+  uint32_t hits_{0};
+  uint32_t misses_{0};
+};
+
+// AliasCache: Bounded cache of the dynamic topic aliases announced by other senders, keyed by
+// (sender MAC, alias). When full, the least recently used binding is replaced.
+class AliasCache {
+ public:
+  void init(size_t capacity) {
+    capacity_ = capacity;
+    entries_.reserve(capacity);
+  }
+  // Record that sender mac uses alias for topic
+  void bind(uint64_t mac, uint16_t alias, std::string_view topic, uint32_t now);
+  // Topic sender mac bound to alias, or nullptr if unknown
+  const std::string *lookup(uint64_t mac, uint16_t alias, uint32_t now);
+  // Drop all bindings of sender mac, e.g. because it restarted and numbers its aliases anew
+  void forget(uint64_t mac);
+  size_t size() const { return entries_.size(); }
+  size_t capacity() const { return capacity_; }
+
+ protected:
+  struct Entry {
+    uint64_t mac;
+    uint16_t alias;
+    uint32_t last_used;  // millis()
+    std::string topic;
+  };
+  Entry *find_(uint64_t mac, uint16_t alias);
+
+  std::vector<Entry> entries_;
+  size_t capacity_{0};
+};
+
+class EspNowPubSub;
+
+// SubscriptionTrigger: Base of the subscription triggers. Remembers the handle of the trigger's
+// subscription so the subscribe/unsubscribe actions can toggle it.
+class SubscriptionTrigger {
+ public:
+  explicit SubscriptionTrigger(EspNowPubSub *parent) : parent_(parent) {}
+  EspNowPubSub *get_parent() const { return parent_; }
+  uint32_t get_handle() const { return handle_; }
+  void set_handle(uint32_t handle) { handle_ = handle; }
+
+ protected:
+  EspNowPubSub *parent_;
+  uint32_t handle_{0};
+};
+
+class OnMessageTrigger; // Forward declarations
+class OnViewMessageTrigger;
+class OnBinaryMessageTrigger;
 
 class EspNowPubSub : public Component,
                      public espnow::ESPNowBroadcastedHandler {
  public:
-  using MessageCallback = std::function<void(const std::string &topic, const std::string &payload, uint32_t sequence)>;
+  // topic and payload view into the queue slot and are only valid for the duration of the call
+  using MessageCallback = std::function<void(std::string_view topic, std::string_view payload, uint32_t sequence,
+                                             const MessageInfo &info, const TopicCaptures &captures)>;
 
   EspNowPubSub();
   float get_setup_priority() const override { return setup_priority::LATE; }
@@ -57,23 +297,86 @@ class EspNowPubSub : public Component,
   void loop() override;
   void dump_config() override;
 
-  // Handler interface for broadcasted messages
+  // Handler interface for broadcasted messages.
+  // Runs in the espnow receive context: only copies the raw frame into rx_ring_.
   bool on_broadcasted(const espnow::ESPNowRecvInfo &info,
                       const uint8_t *data, uint8_t size) override;
 
-  // Only compile-time subscriptions via add_subscription
-  void add_subscription(const std::string &topic, OnMessageTrigger *trigger);
+  // Subscriptions declared in YAML, added by codegen before setup()
+  void add_subscription(const std::string &topic, OnMessageTrigger *trigger, const SubscriptionOptions &options = {});
+  void add_subscription(const std::string &topic, OnViewMessageTrigger *trigger,
+                        const SubscriptionOptions &options = {});
+  void add_subscription(const std::string &topic, OnBinaryMessageTrigger *trigger,
+                        const SubscriptionOptions &options = {});
+
+  // Topics with an alias are sent as a 16-bit alias instead of the topic string. The table must
+  // be the same on all nodes.
+  void add_topic_alias(const std::string &topic, uint16_t alias);
+  // Dynamic aliases: the first max_topics topics published get an alias that is announced to
+  // receivers every announce_interval ms. max_topics 0 disables publishing them.
+  void set_dynamic_aliases(size_t max_topics, uint32_t announce_interval) {
+    dynamic_alias_max_ = max_topics;
+    announce_interval_ = announce_interval;
+  }
+  // Dynamic alias bindings cached from other senders, independent of set_dynamic_aliases() so
+  // every receiver understands dynamic-alias publishers. 0 drops all their aliased frames.
+  void set_alias_cache_size(size_t alias_cache_size) { alias_cache_size_ = alias_cache_size; }
+
+  // Runtime subscriptions. Changes are staged and applied between dispatches by rebuilding the
+  // subscription index, so they take effect from the next message and are safe from callbacks.
+  // Returns a handle for unsubscribe(), never 0.
+  uint32_t subscribe(const std::string &pattern, MessageCallback callback, const SubscriptionOptions &options = {});
+  // Removes a runtime subscription. Declared subscriptions are only paused and can be resumed with
+  // resubscribe(). Returns false for an unknown handle.
+  bool unsubscribe(uint32_t handle);
+  bool resubscribe(uint32_t handle);
 
   void publish(const std::string &topic, const std::string &payload);
-  void receive_message(const std::string &topic, const std::string &payload, uint32_t sequence);
+  void publish(const std::string &topic, const uint8_t *data, size_t size);
+  void publish(const std::string &topic, const std::vector<uint8_t> &data) { publish(topic, data.data(), data.size()); }
+  // info.age is how long the message waited in the queue, checked against each subscription's max_age
+  void receive_message(std::string_view topic, std::string_view payload, uint32_t sequence,
+                       const MessageInfo &info = {});
+  // How often code has been reported since boot
+  uint32_t status_count(StatusCode code) const { return status_counts_[code].load(std::memory_order_relaxed); }
 
   void set_send_times(int send_times) { send_times_ = send_times; }
+  void set_queue_size(size_t queue_size) { lanes_[PRIORITY_NORMAL].size = queue_size; }
+  void set_priority_queue_size(MessagePriority priority, size_t queue_size) { lanes_[priority].size = queue_size; }
+  void set_overflow_policy(OverflowPolicy overflow_policy) { overflow_policy_ = overflow_policy; }
+  void set_dispatch_mode(DispatchMode dispatch_mode) { dispatch_mode_ = dispatch_mode; }
+  void set_dispatch_budget(uint32_t dispatch_budget) { dispatch_budget_ = dispatch_budget; }
+  void set_dispatch_max_messages(size_t dispatch_max_messages) { dispatch_max_messages_ = dispatch_max_messages; }
+  void set_status_interval(uint32_t status_interval) { status_interval_ = status_interval; }
+  void set_peer_capacity(size_t peer_capacity) { peer_capacity_ = peer_capacity; }
+  void set_peer_timeout(uint32_t peer_timeout) { peer_timeout_ = peer_timeout; }
+  void set_match_cache_size(size_t match_cache_size) { match_cache_size_ = match_cache_size; }
+  // Topic index tables compiled by codegen for the first subscription_count subscriptions.
+  // Ignored (the index is built at setup) if the subscriptions no longer match.
+  void set_topic_index(const TopicIndex::Node *nodes, size_t node_count, const TopicIndex::Edge *edges,
+                       const uint16_t *subs, const char *levels, size_t subscription_count) {
+    index_.load(nodes, node_count, edges, subs, levels);
+    compiled_subscription_count_ = subscription_count;
+  }
 
   // Sensor setters
 #ifdef USE_SENSOR
   void set_rssi_sensor(esphome::sensor::Sensor *sensor) { rssi_sensor_ = sensor; }
   void set_sent_count_sensor(esphome::sensor::Sensor *sensor) { sent_count_sensor_ = sensor; }
   void set_received_count_sensor(esphome::sensor::Sensor *sensor) { received_count_sensor_ = sensor; }
+  void set_peer_evictions_sensor(esphome::sensor::Sensor *sensor) { peer_evictions_sensor_ = sensor; }
+  void set_budget_exceeded_sensor(esphome::sensor::Sensor *sensor) { budget_exceeded_sensor_ = sensor; }
+  void set_filtered_count_sensor(esphome::sensor::Sensor *sensor) { filtered_count_sensor_ = sensor; }
+  void set_stale_count_sensor(esphome::sensor::Sensor *sensor) { stale_count_sensor_ = sensor; }
+  void set_alias_miss_count_sensor(esphome::sensor::Sensor *sensor) { alias_miss_count_sensor_ = sensor; }
+  void set_match_cache_hits_sensor(esphome::sensor::Sensor *sensor) { match_cache_hits_sensor_ = sensor; }
+  void set_match_cache_misses_sensor(esphome::sensor::Sensor *sensor) { match_cache_misses_sensor_ = sensor; }
+  void set_exact_dispatch_sensor(esphome::sensor::Sensor *sensor) { exact_dispatch_sensor_ = sensor; }
+  void set_wildcard_dispatch_sensor(esphome::sensor::Sensor *sensor) { wildcard_dispatch_sensor_ = sensor; }
+  // Sensor counting how often code was reported
+  void set_status_count_sensor(StatusCode code, esphome::sensor::Sensor *sensor) {
+    status_count_sensors_[code] = sensor;
+  }
 #endif
 #ifdef USE_TEXT_SENSOR
   void set_status_text_sensor(esphome::text_sensor::TextSensor *sensor) { status_text_sensor_ = sensor; }
@@ -83,56 +386,336 @@ class EspNowPubSub : public Component,
   struct Subscription {
     std::string topic;
     MessageCallback callback;
+    SubscriptionOptions options;
+    uint32_t handle;
+    bool active;  // in the index
+    bool runtime;  // added with subscribe(), removed by unsubscribe()
+    bool wildcard;  // has '+' or '#' levels, i.e. captures
+    CaptureLevels capture_levels;  // for captures after a match cache hit
+    std::string last_payload;  // for PayloadFilter::CHECK_CHANGED
+    bool has_last_payload;
   };
+  // Whether payload passes the filter of sub; remembers it for CHECK_CHANGED if it does
+  bool filter_accepts_(Subscription &sub, std::string_view payload);
+  uint32_t add_subscription_(const std::string &topic, MessageCallback callback, const SubscriptionOptions &options,
+                             bool runtime);
+  void apply_subscription_changes_();
+  void build_index_(bool use_compiled);
+  // The table used for matching; only modified by apply_subscription_changes_() between dispatches.
+  // Index ids are positions in this vector.
   std::vector<Subscription> subscriptions_;
+  // Changes staged by subscribe()/unsubscribe()/resubscribe()
+  std::vector<Subscription> pending_additions_;
+  std::vector<std::pair<uint32_t, bool>> pending_states_;  // handle, subscribed
+  bool subscriptions_changed_{false};
+  bool setup_done_{false};
+  uint32_t next_handle_{1};
+
+  struct TopicAlias {
+    uint16_t alias;
+    std::string topic;
+    uint32_t hash;  // topic_hash() of topic
+    std::vector<uint16_t> matches;  // subscriptions matching topic, resolved in setup()
+    MessagePriority priority;  // lane for the matches, PRIORITY_COUNT if there are none
+  };
+  const TopicAlias *find_alias_(uint16_t alias) const;
+  const TopicAlias *find_alias_(std::string_view topic) const;
+  std::vector<TopicAlias> aliases_;  // sorted by alias in setup()
+  // Subscriptions without wildcards are looked up in exact_index_, the others matched by index_
+  ExactTopicIndex exact_index_;
+  TopicIndex index_;
+  size_t compiled_subscription_count_{0};
+  bool active_changed_{false};  // paused or resumed before setup(), so the compiled index is outdated
+  size_t wildcard_count_{0};  // active subscriptions in index_
+  std::vector<uint16_t> matches_;  // scratch for match_topic_(), reserved in setup()
+  std::vector<uint16_t> exact_matches_;  // scratch for collect_matches_()
+  std::vector<uint16_t> wildcard_matches_;
+  std::vector<TopicCaptures> captures_;  // scratch for receive_message(), parallel to wildcard_matches_
+  // How collect_matches_() uses match_cache_: not at all (alias resolution), read-only without
+  // touching the hit/miss statistics (lane selection), or counted and filled on a miss (dispatch),
+  // so each message counts exactly once and a miss is reported by the lookup that paid for it
+  enum CacheUse : uint8_t { CACHE_BYPASS, CACHE_UNCOUNTED, CACHE_COUNTED };
+  void match_topic_(std::string_view topic, std::vector<uint16_t> &out, CacheUse cache_use,
+                    std::vector<TopicCaptures> *captures = nullptr);
+  // Merge the results of both indexes into out, matching the wildcards behind match_cache_ per cache_use.
+  // If the trie is walked, captures receives the captures of the wildcard matches in order; it is
+  // left empty when they came from the match cache.
+  void collect_matches_(std::string_view topic, uint32_t hash, std::vector<uint16_t> &out, CacheUse cache_use,
+                        std::vector<TopicCaptures> *captures = nullptr);
+  MatchCache match_cache_;
+  size_t match_cache_size_{16};
 
  private:
-  std::string last_status_;
-  uint32_t sent_count_ = 0;
-  uint32_t received_count_ = 0;
+  // Raw frame copied out of the receive callback; parsed later in loop()
+  struct RxFrame {
+    uint8_t src_addr[ESP_NOW_ETH_ALEN];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t size;
+    uint32_t rx_timestamp;  // radio timestamp (us)
+    uint32_t timestamp;     // millis()
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];
+  };
+
+  void send_message_(const std::string &topic, const uint8_t *payload, size_t payload_len);
+  void send_frame_(const std::vector<uint8_t> &frame);
+  std::vector<uint8_t> begin_frame_();
+  bool handle_typed_frame_(const RxFrame &frame, std::string_view &topic, std::string_view &payload,
+                           const TopicAlias *&alias);
+  uint16_t dynamic_alias_(const std::string &topic, bool &created);
+  void announce_aliases_(const std::vector<uint16_t> &aliases);
+  void request_alias_(const uint8_t *mac, uint16_t alias);
+  void dispatch_(std::string_view topic, std::string_view payload, uint32_t sequence, const MessageInfo &info,
+                 const std::vector<uint16_t> &matches, const std::vector<TopicCaptures> &captures);
+  void build_prefilter_();
+  bool prefilter_accepts_(const uint8_t *data, uint8_t size) const;
+  void reclaim_prefilters_();
+  void drain_rx_ring_();
+  void process_frame_(const RxFrame &frame);
+
+  // Status aggregation: recorded atomically from any context, published from loop() at most once
+  // per status_interval_. The last error of an interval is latched, so later successes don't hide
+  // it, and cleared once published.
+  void set_status_(StatusCode code);
+  void mark_status_dirty_();
+  bool flush_status_();
+  std::atomic<uint8_t> status_code_{STATUS_OK};
+  std::array<std::atomic<uint32_t>, STATUS_CODE_COUNT> status_counts_{};
+  std::atomic<bool> status_dirty_{true};
+  uint32_t status_interval_{1000};
+  uint32_t last_status_publish_{0};
+  bool status_published_{false};
+  StatusCode published_status_code_{STATUS_CODE_COUNT};
+
+  std::atomic<uint32_t> sent_count_{0};
+  std::atomic<uint32_t> received_count_{0};
+
+  // Largest topic + payload that fits in one frame after the header and topic terminator
+  static constexpr size_t MAX_MESSAGE_SIZE = ESP_NOW_MAX_DATA_LEN - FRAME_HEADER_LEN - 1;
 
+  static constexpr uint16_t NO_ALIAS = 0xFFFF;
+
+  // Fixed-size message slot; the slab is allocated once in setup()
   struct QueuedMessage {
-    std::string topic;
-    std::string payload;
     uint32_t sequence;
+    MessageInfo info;  // age is filled in at dispatch
+    uint16_t alias;  // index into aliases_ or NO_ALIAS; an aliased topic is not copied into data
+    uint8_t topic_len;
+    uint8_t payload_len;
+    char data[MAX_MESSAGE_SIZE];  // topic immediately followed by payload, not NUL-terminated
+  };
+  std::string_view topic_of_(const QueuedMessage &msg) const {
+    if (msg.alias != NO_ALIAS) return aliases_[msg.alias].topic;
+    return {msg.data, msg.topic_len};
+  }
+
+  // Circular FIFO over a slab of slots; one lane per priority class
+  struct MessageLane {
+    std::vector<QueuedMessage> slab;
+    size_t head{0};
+    size_t count{0};
+    size_t size{0};
+    bool used{false};  // some subscription has this priority; only used lanes get a slab
+
+    QueuedMessage &at(size_t i) { return slab[(head + i) % size]; }
+    void pop() {
+      head = (head + 1) % size;
+      count--;
+    }
   };
-  std::vector<QueuedMessage> message_queue_;
+  QueuedMessage *queue_push_(MessageLane &lane, std::string_view topic);
+  MessageLane *select_lane_(std::string_view topic, const TopicAlias *alias);
+  MessageLane *next_lane_();
+
   static constexpr size_t MAX_QUEUE_SIZE = 16;
+  MessageLane lanes_[PRIORITY_COUNT];
+  size_t lanes_used_{0};
+  OverflowPolicy overflow_policy_{OVERFLOW_DROP_OLDEST};
+  DispatchMode dispatch_mode_{DISPATCH_ALL};
+
+  // Per-loop dispatch limits (0 = unlimited); the remainder is carried over
+  uint32_t dispatch_budget_{10};
+  size_t dispatch_max_messages_{0};
+  uint32_t budget_exceeded_count_{0};
+  uint32_t stale_count_{0};
+  // Trigger executions of exact and wildcard subscriptions
+  uint32_t exact_dispatch_count_{0};
+  uint32_t wildcard_dispatch_count_{0};
+
+  // Single-producer (on_broadcasted) / single-consumer (loop) lock-free ring.
+  // Indices increase monotonically and are masked on access.
+  static constexpr uint32_t RX_RING_SIZE = 16;
+  static_assert((RX_RING_SIZE & (RX_RING_SIZE - 1)) == 0, "RX_RING_SIZE must be a power of two");
+  RxFrame rx_ring_[RX_RING_SIZE];
+  std::atomic<uint32_t> rx_head_{0};  // written by producer only
+  std::atomic<uint32_t> rx_tail_{0};  // written by consumer only
+  std::atomic<uint32_t> rx_overrun_count_{0};
+
+  // Sorted FNV-1a hashes of every active subscription's first topic level. Read from the receive
+  // context, so a rebuild publishes a new snapshot atomically and retires the previous one. Readers
+  // announce themselves in prefilter_readers_ before loading the pointer; retired snapshots are
+  // only freed when no reader is in progress, otherwise on a later loop().
+  struct Prefilter {
+    std::vector<uint32_t> hashes;
+    bool pass_all{false};
+  };
+  std::atomic<const Prefilter *> prefilter_{nullptr};
+  std::unique_ptr<Prefilter> prefilter_current_;
+  std::vector<std::unique_ptr<Prefilter>> prefilter_retired_;
+  mutable std::atomic<uint32_t> prefilter_readers_{0};
+  std::atomic<uint32_t> filtered_count_{0};
+
+  // Dynamic aliases: our own bindings (alias = index) and those learned from other senders
+  struct DynamicAlias {
+    std::string topic;
+    uint32_t hash;  // topic_hash() of topic
+  };
+  std::vector<DynamicAlias> dynamic_aliases_;
+  size_t dynamic_alias_max_{0};
+  uint32_t announce_interval_{60000};
+  std::vector<uint16_t> alias_replies_;  // requested aliases, announced together shortly after
+  AliasCache alias_cache_;
+  size_t alias_cache_size_{16};
+  uint32_t alias_miss_count_{0};  // frames dropped for an unknown dynamic alias
+  bool alias_cache_warned_{false};
+  // Recently requested (mac, alias) keys, so each one is requested at most once per interval
+  struct AliasRequest {
+    uint64_t key;
+    uint32_t time;
+  };
+  std::array<AliasRequest, 8> alias_requests_{};
+  size_t alias_request_next_{0};
+  // Token bucket over all requests, so unknown aliases from many senders can't cause a broadcast storm
+  uint32_t alias_request_tokens_{0};
+  uint32_t alias_request_refill_{0};
+  uint8_t own_mac_[ESP_NOW_ETH_ALEN]{};
 
   int send_times_{1};
-  std::unordered_map<std::string, uint32_t> last_sequence_by_mac_;
+  uint32_t seq_counter_{0};
+  uint16_t epoch_{0};  // sent in every frame header, picked at setup()
+  PeerTable peers_;
+  size_t peer_capacity_{128};
+  uint32_t peer_timeout_{3600000};
 
   // Sensor pointers
 #ifdef USE_SENSOR
   esphome::sensor::Sensor *rssi_sensor_{nullptr};
   esphome::sensor::Sensor *sent_count_sensor_{nullptr};
   esphome::sensor::Sensor *received_count_sensor_{nullptr};
+  esphome::sensor::Sensor *peer_evictions_sensor_{nullptr};
+  esphome::sensor::Sensor *budget_exceeded_sensor_{nullptr};
+  esphome::sensor::Sensor *filtered_count_sensor_{nullptr};
+  esphome::sensor::Sensor *stale_count_sensor_{nullptr};
+  esphome::sensor::Sensor *alias_miss_count_sensor_{nullptr};
+  esphome::sensor::Sensor *match_cache_hits_sensor_{nullptr};
+  esphome::sensor::Sensor *match_cache_misses_sensor_{nullptr};
+  esphome::sensor::Sensor *exact_dispatch_sensor_{nullptr};
+  esphome::sensor::Sensor *wildcard_dispatch_sensor_{nullptr};
+  std::array<esphome::sensor::Sensor *, STATUS_CODE_COUNT> status_count_sensors_{};
 #endif
 #ifdef USE_TEXT_SENSOR
   esphome::text_sensor::TextSensor *status_text_sensor_{nullptr};
 #endif
-  int last_rssi_{0};
+  std::atomic<int> last_rssi_{0};
+};
+
+// OwnedTopicCaptures: The captures of an on_message trigger, copied out of the topic so they stay
+// valid as long as the other trigger arguments, e.g. across a delay. They are stored inline, so
+// making one doesn't allocate; captures[i] only builds a std::string when an automation reads it.
+class OwnedTopicCaptures {
+ public:
+  OwnedTopicCaptures() = default;
+  explicit OwnedTopicCaptures(const TopicCaptures &captures);
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  // Capture i, or an empty string if there is no such capture
+  std::string operator[](size_t i) const;
+
+ protected:
+  std::array<char, ESP_NOW_MAX_DATA_LEN> data_;  // captures never add up to more than the topic
+  std::array<TopicCaptures::Span, TopicCaptures::MAX_CAPTURES> spans_{};  // into data_
+  uint8_t count_{0};
 };
 
 // OnMessageTrigger: Trigger for incoming messages on a topic
-class OnMessageTrigger : public Trigger<std::string, std::string, uint32_t> {
+// topic, payload and captures are owned copies.
+class OnMessageTrigger : public Trigger<std::string, std::string, uint32_t, MessageInfo, OwnedTopicCaptures>,
+                         public SubscriptionTrigger {
  public:
   OnMessageTrigger(EspNowPubSub *parent, const std::string &topic);
 };
 
+// OnViewMessageTrigger: Zero-copy trigger for incoming messages on a topic.
+// topic, payload and captures view into the receive queue slot and are only valid until the automation
+// first yields (delay, wait_until, ...); copy them into a std::string if needed beyond that.
+class OnViewMessageTrigger
+    : public Trigger<std::string_view, std::string_view, uint32_t, MessageInfo, TopicCaptures>,
+      public SubscriptionTrigger {
+ public:
+  OnViewMessageTrigger(EspNowPubSub *parent, const std::string &topic);
+};
+
+// OnBinaryMessageTrigger: Trigger delivering the raw payload bytes as (data, size).
+// data points into the receive queue slot, with the same lifetime as OnViewMessageTrigger's views.
+class OnBinaryMessageTrigger
+    : public Trigger<std::string_view, const uint8_t *, size_t, uint32_t, MessageInfo, TopicCaptures>,
+      public SubscriptionTrigger {
+ public:
+  OnBinaryMessageTrigger(EspNowPubSub *parent, const std::string &topic);
+};
+
 // EspnowPubSubPublishAction: Action to publish a message to a topic
+// Publishes either a string payload or, when set_data() was used, a raw byte payload.
 template<typename... Ts>
 class EspnowPubSubPublishAction : public Action<Ts...> {
  public:
-  EspnowPubSubPublishAction(EspNowPubSub *parent);
-  void set_topic(TemplatableValue<std::string, Ts...> topic);
-  void set_payload(TemplatableValue<std::string, Ts...> payload);
-  void play(const Ts&... x) override;
+  EspnowPubSubPublishAction(EspNowPubSub *parent) : parent_(parent) {}
+  void set_topic(TemplatableValue<std::string, Ts...> topic) { topic_ = std::move(topic); }
+  void set_payload(TemplatableValue<std::string, Ts...> payload) { payload_ = std::move(payload); }
+  void set_data(TemplatableValue<std::vector<uint8_t>, Ts...> data) {
+    data_ = std::move(data);
+    binary_ = true;
+  }
+
+  void play(const Ts&... x) override {
+    if (parent_ == nullptr) {
+      ESP_LOGE("espnow_pubsub", "Parent is null, cannot publish");
+      return;
+    }
+    auto topic = this->topic_.value(x...);
+    if (binary_) {
+      parent_->publish(topic, this->data_.value(x...));
+    } else {
+      parent_->publish(topic, this->payload_.value(x...));
+    }
+  }
 
  protected:
   EspNowPubSub *parent_ = nullptr;
   TemplatableValue<std::string, Ts...>  topic_;
   TemplatableValue<std::string, Ts...> payload_;
+  TemplatableValue<std::vector<uint8_t>, Ts...> data_;
+  bool binary_{false};
+};
+
+// EspnowPubSubSubscribeAction: Resume a paused on_message subscription
+template<typename... Ts> class EspnowPubSubSubscribeAction : public Action<Ts...> {
+ public:
+  explicit EspnowPubSubSubscribeAction(SubscriptionTrigger *trigger) : trigger_(trigger) {}
+  void play(const Ts &...x) override { trigger_->get_parent()->resubscribe(trigger_->get_handle()); }
+
+ protected:
+  SubscriptionTrigger *trigger_;
+};
+
+// EspnowPubSubUnsubscribeAction: Pause an on_message subscription
+template<typename... Ts> class EspnowPubSubUnsubscribeAction : public Action<Ts...> {
+ public:
+  explicit EspnowPubSubUnsubscribeAction(SubscriptionTrigger *trigger) : trigger_(trigger) {}
+  void play(const Ts &...x) override { trigger_->get_parent()->unsubscribe(trigger_->get_handle()); }
+
+ protected:
+  SubscriptionTrigger *trigger_;
 };
 
 }  // namespace espnow_pubsub
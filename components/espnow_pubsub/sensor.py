@@ -23,6 +23,18 @@ import esphome.config_validation as cv
 from esphome.components import sensor
 from . import espnow_pubsub_ns, EspNowPubSub
 
+StatusCode = espnow_pubsub_ns.enum("StatusCode")
+# Per-error counters, one optional sensor each
+STATUS_COUNT_SENSORS = {
+    "rx_empty_count": StatusCode.STATUS_RX_EMPTY,
+    "rx_too_short_count": StatusCode.STATUS_RX_TOO_SHORT,
+    "rx_malformed_count": StatusCode.STATUS_RX_MALFORMED,
+    "rx_ring_full_count": StatusCode.STATUS_RX_RING_FULL,
+    "rx_queue_full_count": StatusCode.STATUS_RX_QUEUE_FULL,
+    "tx_failed_count": StatusCode.STATUS_TX_FAILED,
+    "tx_too_large_count": StatusCode.STATUS_TX_TOO_LARGE,
+}
+
 # Correctly declare component dependencies so ESPHome ensures the
 # base ``espnow_pubsub`` component is initialized before any sensors.
 # The previous misspelled name (``DEPENDANCIES``) meant this list was
@@ -48,6 +60,16 @@ CONFIG_SCHEMA = cv.Schema(
         cv.Optional("rssi"): ESP_NOW_SENSOR_SCHEMA,
         cv.Optional("sent_count"): ESP_NOW_COUNT_SENSOR_SCHEMA,
         cv.Optional("received_count"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        cv.Optional("peer_evictions"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        cv.Optional("budget_exceeded"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        cv.Optional("filtered_count"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        cv.Optional("stale_count"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        cv.Optional("alias_miss_count"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        cv.Optional("match_cache_hits"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        cv.Optional("match_cache_misses"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        cv.Optional("exact_dispatch_count"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        cv.Optional("wildcard_dispatch_count"): ESP_NOW_COUNT_SENSOR_SCHEMA,
+        **{cv.Optional(key): ESP_NOW_COUNT_SENSOR_SCHEMA for key in STATUS_COUNT_SENSORS},
     }
 )
 
@@ -65,3 +87,44 @@ async def to_code(config):
         sens = await sensor.new_sensor(config["received_count"])
         await sensor.register_sensor(sens, config["received_count"])
         cg.add(parent.set_received_count_sensor(sens))
+    if "peer_evictions" in config:
+        sens = await sensor.new_sensor(config["peer_evictions"])
+        await sensor.register_sensor(sens, config["peer_evictions"])
+        cg.add(parent.set_peer_evictions_sensor(sens))
+    if "budget_exceeded" in config:
+        sens = await sensor.new_sensor(config["budget_exceeded"])
+        await sensor.register_sensor(sens, config["budget_exceeded"])
+        cg.add(parent.set_budget_exceeded_sensor(sens))
+    if "filtered_count" in config:
+        sens = await sensor.new_sensor(config["filtered_count"])
+        await sensor.register_sensor(sens, config["filtered_count"])
+        cg.add(parent.set_filtered_count_sensor(sens))
+    if "stale_count" in config:
+        sens = await sensor.new_sensor(config["stale_count"])
+        await sensor.register_sensor(sens, config["stale_count"])
+        cg.add(parent.set_stale_count_sensor(sens))
+    if "alias_miss_count" in config:
+        sens = await sensor.new_sensor(config["alias_miss_count"])
+        await sensor.register_sensor(sens, config["alias_miss_count"])
+        cg.add(parent.set_alias_miss_count_sensor(sens))
+    if "match_cache_hits" in config:
+        sens = await sensor.new_sensor(config["match_cache_hits"])
+        await sensor.register_sensor(sens, config["match_cache_hits"])
+        cg.add(parent.set_match_cache_hits_sensor(sens))
+    if "match_cache_misses" in config:
+        sens = await sensor.new_sensor(config["match_cache_misses"])
+        await sensor.register_sensor(sens, config["match_cache_misses"])
+        cg.add(parent.set_match_cache_misses_sensor(sens))
+    if "exact_dispatch_count" in config:
+        sens = await sensor.new_sensor(config["exact_dispatch_count"])
+        await sensor.register_sensor(sens, config["exact_dispatch_count"])
+        cg.add(parent.set_exact_dispatch_sensor(sens))
+    if "wildcard_dispatch_count" in config:
+        sens = await sensor.new_sensor(config["wildcard_dispatch_count"])
+        await sensor.register_sensor(sens, config["wildcard_dispatch_count"])
+        cg.add(parent.set_wildcard_dispatch_sensor(sens))
+    for key, code in STATUS_COUNT_SENSORS.items():
+        if key in config:
+            sens = await sensor.new_sensor(config[key])
+            await sensor.register_sensor(sens, config[key])
+            cg.add(parent.set_status_count_sensor(code, sens))
@@ -0,0 +1,309 @@
+// MIT License
+// Copyright (c) 2025 Mark Johnson
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include "topic_index.h"
+
+namespace esphome {
+namespace espnow_pubsub {
+
+// MQTT-style topic matching with wildcards (defined in topic_index.h).
+// The documented examples double as regression tests, checked at compile time:
+static_assert(mqtt_topic_matches("foo/bar/#", "foo/bar/baz/qux"));
+static_assert(mqtt_topic_matches("foo/+/baz", "foo/x/baz"));
+static_assert(!mqtt_topic_matches("foo/+/baz", "foo/x/y/baz"));
+static_assert(mqtt_topic_matches("foo/#", "foo"));
+static_assert(mqtt_topic_matches("foo/#", "foo/bar"));
+static_assert(mqtt_topic_matches("foo/bar", "foo/bar"));
+static_assert(!mqtt_topic_matches("foo/bar", "foo/bar/baz"));
+// '#' must be the last level
+static_assert(!mqtt_topic_matches("foo/#/bar", "foo/x/bar"));
+static_assert(mqtt_topic_matches("#", ""));
+static_assert(!mqtt_topic_matches("+", ""));
+// A single trailing '/' does not start an empty level
+static_assert(mqtt_topic_matches("foo", "foo/"));
+static_assert(mqtt_topic_matches("foo/+/baz", "foo//baz"));
+
+// ExactTopicIndex compares the key()s of non-empty topics; that must agree with the matcher
+static constexpr bool exact_agrees(std::string_view sub, std::string_view topic) {
+  return mqtt_topic_matches(sub, topic) == (ExactTopicIndex::key(sub) == ExactTopicIndex::key(topic));
+}
+static_assert(exact_agrees("foo", "foo/") && mqtt_topic_matches("foo", "foo/"));
+static_assert(exact_agrees("bar/", "bar") && mqtt_topic_matches("bar/", "bar"));
+static_assert(exact_agrees("a/", "a/") && exact_agrees("a//", "a/") && exact_agrees("a//", "a//"));
+static_assert(exact_agrees("/", "//") && exact_agrees("//", "/") && exact_agrees("/", "/"));
+
+// Whether matching topic against sub captures exactly expected
+static constexpr bool captures_are(std::string_view sub, std::string_view topic,
+                                   std::initializer_list<std::string_view> expected) {
+  TopicCaptures captures;
+  if (!mqtt_topic_matches(sub, topic, &captures) || captures.size() != expected.size()) return false;
+  size_t i = 0;
+  for (std::string_view capture : expected) {
+    if (captures[i++] != capture) return false;
+  }
+  return true;
+}
+static_assert(captures_are("sensor/+/data", "sensor/kitchen/data", {"kitchen"}));
+static_assert(captures_are("+/+/#", "a/b/c/d", {"a", "b", "c/d"}));
+static_assert(captures_are("foo/#", "foo", {""}));
+static_assert(captures_are("#", "a/b", {"a/b"}));
+static_assert(captures_are("foo/+/baz", "foo//baz", {""}));
+static_assert(captures_are("foo/bar", "foo/bar", {}));
+
+// CaptureLevels must capture what the matcher captures
+static constexpr bool levels_agree(std::string_view sub, std::string_view topic) {
+  TopicCaptures captures;
+  if (!mqtt_topic_matches(sub, topic, &captures)) return false;
+  const TopicCaptures extracted = CaptureLevels::of(sub).extract(topic);
+  if (extracted.size() != captures.size()) return false;
+  for (size_t i = 0; i < captures.size(); i++) {
+    if (extracted[i] != captures[i]) return false;
+  }
+  return true;
+}
+static_assert(levels_agree("sensor/+/data", "sensor/kitchen/data"));
+static_assert(levels_agree("+/+/#", "a/b/c/d") && levels_agree("foo/#", "foo") && levels_agree("foo/#", "foo/"));
+static_assert(levels_agree("#", "a/b") && levels_agree("#", "") && levels_agree("foo/+/baz", "foo//baz"));
+static_assert(levels_agree("+/#", "a/b/") && levels_agree("foo/bar", "foo/bar"));
+
+// TopicIndex
+// Levels are split exactly like mqtt_topic_matches() does: a single trailing '/' does not start
+// an empty level, so "foo/" has the one level "foo".
+void TopicIndex::add(std::string_view pattern, uint16_t id) {
+  size_t hash_pos = pattern.find('#');
+  if (hash_pos != std::string_view::npos && hash_pos != pattern.size() - 1) return;
+  if (build_.empty()) build_.emplace_back();
+  size_t node = 0;
+  size_t pos = 0;
+  while (pos < pattern.size()) {
+    size_t next = std::min(pattern.find('/', pos), pattern.size());
+    std::string_view level = pattern.substr(pos, next - pos);
+    if (level == "#") {
+      build_[node].hash_subs.push_back(id);
+      return;
+    }
+    uint16_t child = TopicIndex::NO_NODE;
+    if (level == "+") {
+      child = build_[node].plus_child;
+    } else {
+      for (const auto &edge : build_[node].children) {
+        if (edge.first == level) child = edge.second;
+      }
+    }
+    if (child == NO_NODE) {
+      child = build_.size();
+      if (level == "+") {
+        build_[node].plus_child = child;
+      } else {
+        build_[node].children.emplace_back(std::string(level), child);
+      }
+      build_.emplace_back();  // invalidates references into build_
+    }
+    node = child;
+    pos = next < pattern.size() ? next + 1 : next;
+  }
+  build_[node].end_subs.push_back(id);
+}
+
+void TopicIndex::finalize() {
+  std::vector<Node> nodes;
+  std::vector<Edge> edges;
+  std::vector<uint16_t> subs;
+  std::string levels;
+  if (build_.empty()) build_.emplace_back();
+
+  // Number the nodes breadth first so every node's literal children are contiguous in edges_
+  std::vector<uint16_t> order{0};
+  std::vector<uint16_t> flat_index(build_.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    flat_index[order[i]] = i;
+    for (const auto &edge : build_[order[i]].children) order.push_back(edge.second);
+    if (build_[order[i]].plus_child != NO_NODE) order.push_back(build_[order[i]].plus_child);
+  }
+
+  nodes.reserve(order.size());
+  for (uint16_t b : order) {
+    const BuildNode &src = build_[b];
+    Node node;
+    node.edges_begin = edges.size();
+    node.edge_count = src.children.size();
+    node.plus_child = src.plus_child == NO_NODE ? NO_NODE : flat_index[src.plus_child];
+    node.subs_begin = subs.size();
+    node.end_count = src.end_subs.size();
+    node.hash_count = src.hash_subs.size();
+    for (const auto &child : src.children) {
+      edges.push_back({topic_hash(child.first.data(), child.first.size()), static_cast<uint32_t>(levels.size()),
+                       static_cast<uint16_t>(child.first.size()), flat_index[child.second]});
+      levels += child.first;
+    }
+    std::sort(edges.begin() + node.edges_begin, edges.end(),
+              [](const Edge &a, const Edge &b) { return a.hash < b.hash; });
+    subs.insert(subs.end(), src.end_subs.begin(), src.end_subs.end());
+    subs.insert(subs.end(), src.hash_subs.begin(), src.hash_subs.end());
+    nodes.push_back(node);
+  }
+  build_.clear();
+  build_.shrink_to_fit();
+
+  node_buf_ = std::move(nodes);
+  edge_buf_ = std::move(edges);
+  sub_buf_ = std::move(subs);
+  level_buf_ = std::move(levels);
+  nodes_ = node_buf_.data();
+  node_count_ = node_buf_.size();
+  edges_ = edge_buf_.data();
+  subs_ = sub_buf_.data();
+  levels_ = level_buf_.data();
+  loaded_ = false;
+}
+
+void TopicIndex::load(const Node *nodes, size_t node_count, const Edge *edges, const uint16_t *subs,
+                      const char *levels) {
+  nodes_ = nodes;
+  node_count_ = node_count;
+  edges_ = edges;
+  subs_ = subs;
+  levels_ = levels;
+  loaded_ = true;
+}
+
+void TopicIndex::match(std::string_view topic, std::vector<uint16_t> &out,
+                       std::vector<TopicCaptures> *captures) const {
+  out.clear();
+  if (captures != nullptr) captures->clear();
+  if (node_count_ == 0) return;
+  TopicCaptures path{topic};
+  match_(0, 0, path, out, captures);
+  // Each node is visited at most once, so ids are unique; restore subscription order
+  if (captures == nullptr) {
+    std::sort(out.begin(), out.end());
+    return;
+  }
+  // Keep each id's captures next to it. Only a handful of patterns match one topic, so an
+  // insertion sort is cheap and, unlike sorting through a permutation, doesn't allocate.
+  for (size_t i = 1; i < out.size(); i++) {
+    for (size_t j = i; j > 0 && out[j - 1] > out[j]; j--) {
+      std::swap(out[j - 1], out[j]);
+      std::swap((*captures)[j - 1], (*captures)[j]);
+    }
+  }
+}
+
+// match_(): Visit node with the topic consumed up to pos
+void TopicIndex::match_(uint16_t node_idx, size_t pos, TopicCaptures &path, std::vector<uint16_t> &out,
+                        std::vector<TopicCaptures> *captures) const {
+  const Node &node = nodes_[node_idx];
+  const uint16_t *subs = subs_ + node.subs_begin;
+  const char *topic = path.topic.data();
+  const size_t size = path.topic.size();
+  // '#' matches all remaining levels, including none; it captures them without the leading '/'
+  out.insert(out.end(), subs + node.end_count, subs + node.end_count + node.hash_count);
+  if (captures != nullptr && node.hash_count > 0) {
+    TopicCaptures rest = path;
+    rest.add(topic + pos, topic + size);
+    captures->insert(captures->end(), node.hash_count, rest);
+  }
+  if (pos >= size) {
+    out.insert(out.end(), subs, subs + node.end_count);
+    if (captures != nullptr) captures->insert(captures->end(), node.end_count, path);
+    return;
+  }
+
+  size_t end = pos;
+  while (end < size && topic[end] != '/') end++;
+  const size_t next = end < size ? end + 1 : end;
+  const size_t len = end - pos;
+
+  if (node.edge_count > 0) {
+    const uint32_t hash = topic_hash(topic + pos, len);
+    const Edge *last = edges_ + node.edges_begin + node.edge_count;
+    const Edge *edge = std::lower_bound(edges_ + node.edges_begin, last, hash,
+                                        [](const Edge &e, uint32_t h) { return e.hash < h; });
+    for (; edge != last && edge->hash == hash; edge++) {
+      if (edge->level_len == len && memcmp(levels_ + edge->level, topic + pos, len) == 0) {
+        match_(edge->child, next, path, out, captures);
+        break;
+      }
+    }
+  }
+  if (node.plus_child != NO_NODE) {
+    const uint8_t count = path.count;
+    path.add(topic + pos, topic + end);
+    match_(node.plus_child, next, path, out, captures);
+    path.count = count;
+  }
+}
+
+// ExactTopicIndex
+void ExactTopicIndex::add(std::string_view topic, uint16_t id) {
+  if (topic.empty()) {
+    empty_subs_.push_back(id);
+    return;
+  }
+  topic = key(topic);
+  uint32_t hash = topic_hash(topic.data(), topic.size());
+  for (auto &entry : entries_) {
+    if (entry.hash == hash && entry.topic == topic) {
+      entry.subs.push_back(id);
+      return;
+    }
+  }
+  entries_.push_back({hash, std::string(topic), {id}});
+}
+
+void ExactTopicIndex::finalize() {
+  slots_.clear();
+  if (entries_.empty()) return;
+  // At most half full keeps the probe sequences short
+  size_t size = 1;
+  while (size < entries_.size() * 2) size <<= 1;
+  slots_.assign(size, EMPTY);
+  for (size_t i = 0; i < entries_.size(); i++) {
+    size_t slot = entries_[i].hash & (size - 1);
+    while (slots_[slot] != EMPTY) slot = (slot + 1) & (size - 1);
+    slots_[slot] = i;
+  }
+}
+
+void ExactTopicIndex::match(std::string_view topic, uint32_t hash, std::vector<uint16_t> &out) const {
+  out.clear();
+  if (topic.empty()) {
+    out.assign(empty_subs_.begin(), empty_subs_.end());
+    return;
+  }
+  if (slots_.empty()) return;
+  if (key(topic).size() != topic.size()) {
+    topic = key(topic);
+    hash = topic_hash(topic.data(), topic.size());
+  }
+  const size_t mask = slots_.size() - 1;
+  for (size_t slot = hash & mask; slots_[slot] != EMPTY; slot = (slot + 1) & mask) {
+    const Entry &entry = entries_[slots_[slot]];
+    if (entry.hash == hash && entry.topic == topic) {
+      out.assign(entry.subs.begin(), entry.subs.end());
+      return;
+    }
+  }
+}
+}  // namespace espnow_pubsub
+}  // namespace esphome
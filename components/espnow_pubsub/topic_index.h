@@ -0,0 +1,274 @@
+// MIT License
+// Copyright (c) 2025 Mark Johnson
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Topic matching used by the component and by the host programs in tests/host/. It doesn't depend
+// on ESPHome, so it builds with any C++17 compiler.
+
+namespace esphome {
+namespace espnow_pubsub {
+
+// Wildcard captures of a topic match: the level matched by each '+' and the remainder matched by
+// '#', in pattern order, stored as offset/length pairs into the matched topic.
+// captures[i] views into the topic, so it is only valid as long as the topic is.
+struct TopicCaptures {
+  static constexpr uint8_t MAX_CAPTURES = 8;  // further wildcards still match but aren't captured
+
+  struct Span {
+    uint16_t offset;
+    uint16_t length;
+  };
+
+  std::string_view topic;
+  std::array<Span, MAX_CAPTURES> spans{};
+  uint8_t count{0};
+
+  constexpr size_t size() const { return count; }
+  // Capture i, or an empty view if there is no such capture
+  constexpr std::string_view operator[](size_t i) const {
+    return i < count ? topic.substr(spans[i].offset, spans[i].length) : std::string_view();
+  }
+  // Record [begin, end) of topic as the next capture
+  constexpr void add(const char *begin, const char *end) {
+    if (count < MAX_CAPTURES) {
+      spans[count++] = {static_cast<uint16_t>(begin - topic.data()), static_cast<uint16_t>(end - begin)};
+    }
+  }
+};
+
+// Helper: MQTT topic match with wildcards
+// Supports + (single-level) and # (multi-level, must be the last level) wildcards.
+// Compares levels in place, without allocating. If captures is given, the levels matched by the
+// wildcards are recorded in it (its contents are unspecified when the topic doesn't match).
+//
+// Example matches:
+//   sub = "foo/bar/#", topic = "foo/bar/baz/qux"   => true
+//   sub = "foo/+/baz", topic = "foo/x/baz"          => true
+//   sub = "foo/+/baz", topic = "foo/x/y/baz"        => false
+//   sub = "foo/#", topic = "foo"                     => true
+//   sub = "foo/#", topic = "foo/bar"                 => true
+//   sub = "foo/bar", topic = "foo/bar"               => true
+//   sub = "foo/bar", topic = "foo/bar/baz"           => false
+//
+// Example captures:
+//   sub = "sensor/+/data", topic = "sensor/kitchen/data"  => ["kitchen"]
+//   sub = "+/+/#", topic = "a/b/c/d"                      => ["a", "b", "c/d"]
+//   sub = "foo/#", topic = "foo"                           => [""]
+constexpr bool mqtt_topic_matches(std::string_view sub, std::string_view topic, TopicCaptures *captures = nullptr) {
+  const char *s = sub.data(), *s_end = sub.data() + sub.size();
+  const char *t = topic.data(), *t_end = topic.data() + topic.size();
+  if (captures != nullptr) *captures = TopicCaptures{topic};
+  // Walk both level by level (split by '/')
+  while (s != s_end && t != t_end) {
+    const char *s_next = s;
+    while (s_next != s_end && *s_next != '/') s_next++;
+    const char *t_next = t;
+    while (t_next != t_end && *t_next != '/') t_next++;
+
+    if (s_next - s == 1 && *s == '#') {
+      // '#' matches all remaining levels, but only as the last level of sub
+      if (captures != nullptr) captures->add(t, t_end);
+      return s_next == s_end;
+    }
+    if (s_next - s == 1 && *s == '+') {
+      if (captures != nullptr) captures->add(t, t_next);
+    } else {
+      // Literal level: must equal the topic level
+      if (s_next - s != t_next - t) return false;
+      for (const char *a = s, *b = t; a != s_next; a++, b++) {
+        if (*a != *b) return false;
+      }
+    }
+    s = s_next == s_end ? s_end : s_next + 1;
+    t = t_next == t_end ? t_end : t_next + 1;
+  }
+  // Trailing '#' in sub also matches zero remaining levels
+  if (s_end - s == 1 && *s == '#') {
+    if (captures != nullptr) captures->add(t_end, t_end);
+    return true;
+  }
+  // Otherwise both must be fully consumed
+  return s == s_end && t == t_end;
+}
+
+// CaptureLevels: The levels of a pattern that hold its first MAX_CAPTURES wildcards, so the captures
+// of a topic known to match it (e.g. from the match cache) are taken from the topic alone, without
+// comparing against the pattern again. Levels are split as in mqtt_topic_matches().
+struct CaptureLevels {
+  std::array<uint8_t, TopicCaptures::MAX_CAPTURES> levels{};
+  uint8_t count{0};
+  bool ends_in_hash{false};  // levels[count - 1] is a '#'
+
+  static constexpr CaptureLevels of(std::string_view pattern) {
+    CaptureLevels result;
+    const char *p = pattern.data(), *p_end = pattern.data() + pattern.size();
+    for (size_t level = 0; p != p_end && result.count < TopicCaptures::MAX_CAPTURES; level++) {
+      const char *p_next = p;
+      while (p_next != p_end && *p_next != '/') p_next++;
+      if (p_next - p == 1 && (*p == '+' || *p == '#')) {
+        result.levels[result.count++] = static_cast<uint8_t>(level);
+        if (*p == '#') {
+          result.ends_in_hash = true;
+          break;
+        }
+      }
+      p = p_next == p_end ? p_end : p_next + 1;
+    }
+    return result;
+  }
+
+  // The captures of topic, which must match the pattern
+  constexpr TopicCaptures extract(std::string_view topic) const {
+    TopicCaptures captures{topic};
+    const char *t = topic.data(), *t_end = topic.data() + topic.size();
+    size_t next = 0;
+    for (size_t level = 0; t != t_end && next < count; level++) {
+      const char *t_next = t;
+      while (t_next != t_end && *t_next != '/') t_next++;
+      if (levels[next] == level) {
+        const bool hash = ends_in_hash && next + 1 == count;
+        captures.add(t, hash ? t_end : t_next);
+        if (hash) return captures;
+        next++;
+      }
+      t = t_next == t_end ? t_end : t_next + 1;
+    }
+    // A '#' that matched no levels
+    if (next < count) captures.add(t_end, t_end);
+    return captures;
+  }
+};
+
+// FNV-1a hash of a topic or topic level
+inline uint32_t topic_hash(const char *data, size_t len) {
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+// TopicIndex: Level-by-level trie over subscription topic patterns, built once in setup().
+// Literal levels are child edges (sorted by topic_hash(), verified against the level text), '+' is
+// a single wildcard child per node and patterns ending in '#' are stored on the node '#' hangs off.
+// match() walks the trie once per topic with the same semantics as mqtt_topic_matches().
+// The tables are either built at runtime (add()/finalize()) or generated by codegen in the same
+// layout and placed in flash (load()).
+class TopicIndex {
+ public:
+  static constexpr uint16_t NO_NODE = 0xFFFF;
+
+  struct Node {
+    uint16_t edges_begin;  // literal children: edges_[edges_begin, edges_begin + edge_count)
+    uint16_t edge_count;
+    uint16_t plus_child;  // '+' child or NO_NODE
+    uint16_t subs_begin;  // subs_[subs_begin, +end_count): patterns ending at this node,
+    uint16_t end_count;   // followed by hash_count patterns ending in '#' below it
+    uint16_t hash_count;
+  };
+  struct Edge {
+    uint32_t hash;  // topic_hash() of the level
+    uint32_t level;  // offset of the level text in levels_
+    uint16_t level_len;
+    uint16_t child;
+  };
+
+  // Add pattern as subscription id; call finalize() once all patterns are added.
+  // Patterns with a '#' that is not the last character never match and are left out.
+  void add(std::string_view pattern, uint16_t id);
+  // Flatten the added patterns into the lookup tables and release the build state
+  void finalize();
+  // Use prebuilt tables instead; they must stay valid for the lifetime of the index
+  void load(const Node *nodes, size_t node_count, const Edge *edges, const uint16_t *subs, const char *levels);
+  // Collect the ids of all patterns matching topic into out, in ascending order. If captures is
+  // given, (*captures)[i] receives the captures of out[i], recorded during the same walk.
+  void match(std::string_view topic, std::vector<uint16_t> &out, std::vector<TopicCaptures> *captures = nullptr) const;
+  size_t node_count() const { return node_count_; }
+  bool is_loaded() const { return loaded_; }
+
+ protected:
+  struct BuildNode {
+    std::vector<std::pair<std::string, uint16_t>> children;
+    uint16_t plus_child{NO_NODE};
+    std::vector<uint16_t> end_subs;
+    std::vector<uint16_t> hash_subs;
+  };
+  // path holds the captures of the '+' edges taken to reach node; captures is null if not recording
+  void match_(uint16_t node, size_t pos, TopicCaptures &path, std::vector<uint16_t> &out,
+              std::vector<TopicCaptures> *captures) const;
+
+  std::vector<BuildNode> build_;
+  // Tables owned by a runtime-built index
+  std::vector<Node> node_buf_;
+  std::vector<Edge> edge_buf_;
+  std::vector<uint16_t> sub_buf_;
+  std::string level_buf_;
+
+  const Node *nodes_{nullptr};  // root is nodes_[0]
+  size_t node_count_{0};
+  const Edge *edges_{nullptr};
+  const uint16_t *subs_{nullptr};
+  const char *levels_{nullptr};
+  bool loaded_{false};
+};
+
+// ExactTopicIndex: Hash table of the subscriptions without wildcards, keyed by topic_hash() of the
+// whole topic (open addressing, linear probing). Entries keep their topic, so lookups are verified.
+// Patterns and topics are compared by key(), so a single trailing '/' is ignored the same way
+// mqtt_topic_matches() ignores it. The empty topic (no levels, unlike "/") is kept apart.
+class ExactTopicIndex {
+ public:
+  // The topic without one trailing '/'
+  static constexpr std::string_view key(std::string_view topic) {
+    return !topic.empty() && topic.back() == '/' ? topic.substr(0, topic.size() - 1) : topic;
+  }
+
+  // Add topic as subscription id, in ascending id order; call finalize() once all topics are added
+  void add(std::string_view topic, uint16_t id);
+  void finalize();
+  // Collect the ids of the subscriptions to exactly topic into out, in ascending order.
+  // hash must be topic_hash() of topic (as received, before key()).
+  void match(std::string_view topic, uint32_t hash, std::vector<uint16_t> &out) const;
+  size_t size() const { return entries_.size(); }
+
+ protected:
+  static constexpr uint16_t EMPTY = 0xFFFF;
+
+  struct Entry {
+    uint32_t hash;
+    std::string topic;
+    std::vector<uint16_t> subs;
+  };
+  std::vector<Entry> entries_;
+  std::vector<uint16_t> slots_;  // entry index or EMPTY, power of two sized
+  std::vector<uint16_t> empty_subs_;  // subscriptions to the empty topic
+};
+}  // namespace espnow_pubsub
+}  // namespace esphome
@@ -0,0 +1,181 @@
+// MIT License
+// Copyright (c) 2025 Mark Johnson
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Host-side comparison and microbenchmark of mqtt_topic_matches() against the substr()-based
+// matcher it replaced, no ESPHome needed. Build and run from the repository root:
+//
+//   g++ -std=c++17 -O2 -I components/espnow_pubsub -o mqtt_match_bench tests/host/mqtt_match_bench.cpp
+//   ./mqtt_match_bench
+//
+// Checks that both matchers agree on every pattern/topic pair up to 4 characters over the alphabet
+// "ab/+#" and on random longer pairs, and that the current one never allocates. Then times both
+// on gateway-like patterns and topics. Exits non-zero on any disagreement or allocation.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "topic_index.h"
+
+using esphome::espnow_pubsub::mqtt_topic_matches;
+using esphome::espnow_pubsub::TopicCaptures;
+
+// Count heap allocations, to show that mqtt_topic_matches() makes none
+static size_t g_allocations = 0;
+void *operator new(size_t size) {
+  g_allocations++;
+  if (void *p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+// The previous implementation, kept verbatim as the reference
+bool legacy_topic_matches(const std::string &sub, const std::string &topic) {
+  size_t sub_pos = 0, topic_pos = 0;
+  // Iterate through both sub and topic, token by token (split by '/')
+  while (sub_pos < sub.size() && topic_pos < topic.size()) {
+    // Find next '/' in both sub and topic
+    size_t sub_next = sub.find('/', sub_pos);
+    size_t topic_next = topic.find('/', topic_pos);
+    // Extract current token for sub and topic
+    std::string sub_token = sub.substr(sub_pos, sub_next == std::string::npos ? sub.size() - sub_pos : sub_next - sub_pos);
+    std::string topic_token = topic.substr(topic_pos, topic_next == std::string::npos ? topic.size() - topic_pos : topic_next - topic_pos);
+
+    if (sub_token == "#") {
+      // '#' matches all remaining topic levels, but must be last token in sub
+      // If '#' is not the last token, it's not a valid match (strict MQTT semantics)
+      return (sub_next == std::string::npos);
+    } else if (sub_token == "+") {
+      // '+' matches any single topic level, so continue to next token
+    } else if (sub_token != topic_token) {
+      // Tokens do not match and no wildcard, so not a match
+      return false;
+    }
+    // Advance to next token in both sub and topic
+    sub_pos = (sub_next == std::string::npos) ? sub.size() : sub_next + 1;
+    topic_pos = (topic_next == std::string::npos) ? topic.size() : topic_next + 1;
+  }
+  // Allow trailing '#' in sub to match any remaining topic levels (including zero levels)
+  if (sub_pos < sub.size() && sub.substr(sub_pos) == "#") return true;
+  // Only match if both sub and topic are fully consumed
+  return sub_pos == sub.size() && topic_pos == topic.size();
+}
+
+const char ALPHABET[] = "ab/+#";
+
+// All strings of up to max_len characters over ALPHABET
+std::vector<std::string> all_strings(size_t max_len) {
+  std::vector<std::string> strings{""};
+  for (size_t begin = 0; strings[begin].size() < max_len; begin++) {
+    for (const char *c = ALPHABET; *c != '\0'; c++) strings.push_back(strings[begin] + *c);
+  }
+  return strings;
+}
+
+bool check_agreement() {
+  size_t checked = 0, disagreements = 0;
+  auto compare = [&](const std::string &sub, const std::string &topic) {
+    checked++;
+    if (legacy_topic_matches(sub, topic) != mqtt_topic_matches(sub, topic) && disagreements++ < 10) {
+      printf("disagree: sub '%s', topic '%s'\n", sub.c_str(), topic.c_str());
+    }
+  };
+  const std::vector<std::string> strings = all_strings(4);
+  for (const auto &sub : strings) {
+    for (const auto &topic : strings) compare(sub, topic);
+  }
+  std::mt19937 rng(1);
+  for (int i = 0; i < 1000000; i++) {
+    std::string sub, topic;
+    for (int n = rng() % 12; n > 0; n--) sub += ALPHABET[rng() % 5];
+    for (int n = rng() % 12; n > 0; n--) topic += ALPHABET[rng() % 5];
+    compare(sub, topic);
+  }
+  printf("agreement: %zu pairs checked, %zu disagreements\n", checked, disagreements);
+  return disagreements == 0;
+}
+
+template<typename F> double ns_per_match(const std::vector<std::string> &subs, const std::vector<std::string> &topics,
+                                         size_t &matches, size_t &allocations, F match) {
+  const int passes = 20;
+  const size_t allocations_before = g_allocations;
+  const auto start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < passes; pass++) {
+    for (const auto &topic : topics) {
+      for (const auto &sub : subs) matches += match(sub, topic);
+    }
+  }
+  const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  allocations = g_allocations - allocations_before;
+  return elapsed.count() / (passes * topics.size() * subs.size());
+}
+
+bool benchmark() {
+  // Topic levels longer than the small string buffer, as on a real gateway
+  const std::vector<std::string> subs = {
+      "home/livingroom/thermostat/temperature", "home/+/thermostat/temperature", "home/livingroom/#",
+      "home/+/+/humidity", "garden/weatherstation/wind_speed", "#"};
+  std::vector<std::string> topics;
+  std::mt19937 rng(2);
+  const char *const rooms[] = {"livingroom", "kitchen_downstairs", "bedroom"};
+  const char *const devices[] = {"thermostat", "window_contact", "multisensor"};
+  const char *const metrics[] = {"temperature", "humidity", "battery_level"};
+  for (int i = 0; i < 500; i++) {
+    topics.push_back(std::string("home/") + rooms[rng() % 3] + "/" + devices[rng() % 3] + "/" + metrics[rng() % 3]);
+  }
+
+  size_t legacy_matches = 0, matches = 0, legacy_allocations = 0, allocations = 0;
+  const double legacy = ns_per_match(subs, topics, legacy_matches, legacy_allocations,
+                                     [](const std::string &sub, const std::string &topic) {
+                                       return legacy_topic_matches(sub, topic);
+                                     });
+  const double current = ns_per_match(subs, topics, matches, allocations,
+                                      [](const std::string &sub, const std::string &topic) {
+                                        return mqtt_topic_matches(sub, topic);
+                                      });
+  size_t capture_matches = 0, capture_allocations = 0;
+  const double captured = ns_per_match(subs, topics, capture_matches, capture_allocations,
+                                       [](const std::string &sub, const std::string &topic) {
+                                         TopicCaptures captures;
+                                         return mqtt_topic_matches(sub, topic, &captures);
+                                       });
+  printf("legacy:              %6.1f ns per match, %zu allocations\n", legacy, legacy_allocations);
+  printf("in place:            %6.1f ns per match, %zu allocations\n", current, allocations);
+  printf("in place + captures: %6.1f ns per match, %zu allocations\n", captured, capture_allocations);
+  if (matches != legacy_matches || capture_matches != legacy_matches) {
+    printf("match counts differ: %zu legacy, %zu in place, %zu with captures\n", legacy_matches, matches,
+           capture_matches);
+    return false;
+  }
+  return allocations == 0 && capture_allocations == 0;
+}
+
+}  // namespace
+
+int main() {
+  if (!check_agreement()) return 1;
+  return benchmark() ? 0 : 1;
+}
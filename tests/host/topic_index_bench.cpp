@@ -0,0 +1,230 @@
+// MIT License
+// Copyright (c) 2025 Mark Johnson
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Host-side check and benchmark of the subscription matching in topic_index.h, no ESPHome needed:
+//
+//   g++ -std=c++17 -O2 -I components/espnow_pubsub -o topic_index_bench
+//       tests/host/topic_index_bench.cpp components/espnow_pubsub/topic_index.cpp
+//   ./topic_index_bench
+//
+// (run from the repository root)
+//
+// First checks that TopicIndex and ExactTopicIndex return exactly the subscriptions a linear scan
+// with mqtt_topic_matches() does, and that the captures recorded by the trie walk and those taken
+// from CaptureLevels equal the matcher's, on random patterns and topics built from a small alphabet
+// of levels (including '+', '#', empty levels and trailing '/'). Then times matching a stream of
+// topics against 10, 100 and 1000 subscriptions three ways: the linear scan that
+// receive_message() used to do, the trie alone, and the exact table plus trie as the component
+// does it. Exits non-zero on any mismatch.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+#include "topic_index.h"
+
+using esphome::espnow_pubsub::CaptureLevels;
+using esphome::espnow_pubsub::ExactTopicIndex;
+using esphome::espnow_pubsub::mqtt_topic_matches;
+using esphome::espnow_pubsub::topic_hash;
+using esphome::espnow_pubsub::TopicCaptures;
+using esphome::espnow_pubsub::TopicIndex;
+
+namespace {
+
+bool has_wildcard(const std::string &pattern) { return pattern.find_first_of("+#") != std::string::npos; }
+
+// The component's split: wildcard patterns in the trie, the others in the exact table
+struct Indexes {
+  TopicIndex trie;
+  ExactTopicIndex exact;
+  std::vector<uint16_t> exact_out, wildcard_out;
+
+  explicit Indexes(const std::vector<std::string> &patterns) {
+    for (size_t i = 0; i < patterns.size(); i++) {
+      if (has_wildcard(patterns[i])) {
+        trie.add(patterns[i], i);
+      } else {
+        exact.add(patterns[i], i);
+      }
+    }
+    trie.finalize();
+    exact.finalize();
+  }
+  void match(const std::string &topic, std::vector<uint16_t> &out) {
+    exact.match(topic, topic_hash(topic.data(), topic.size()), exact_out);
+    trie.match(topic, wildcard_out);
+    out.clear();
+    std::merge(exact_out.begin(), exact_out.end(), wildcard_out.begin(), wildcard_out.end(), std::back_inserter(out));
+  }
+};
+
+void linear_match(const std::vector<std::string> &patterns, const std::string &topic, std::vector<uint16_t> &out) {
+  out.clear();
+  for (size_t i = 0; i < patterns.size(); i++) {
+    if (mqtt_topic_matches(patterns[i], topic)) out.push_back(i);
+  }
+}
+
+// Random patterns and topics over a tiny alphabet, so that matches and edge cases are frequent
+std::string random_topic(std::mt19937 &rng, bool pattern) {
+  static const char *const LEVELS[] = {"a", "b", "ab", "", "+", "#"};
+  std::string topic;
+  const int levels = rng() % 5;
+  for (int i = 0; i < levels; i++) {
+    if (i > 0) topic += '/';
+    topic += LEVELS[rng() % (pattern ? 6 : 4)];
+  }
+  if (rng() % 6 == 0) topic += '/';
+  return topic;
+}
+
+bool same_captures(const TopicCaptures &a, const TopicCaptures &b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+// Whether the trie's ids and captures equal those of the matcher, for the wildcard patterns
+bool same_wildcard_matches(const std::vector<std::string> &patterns, const std::string &topic,
+                           const std::vector<uint16_t> &ids, const std::vector<TopicCaptures> &captures) {
+  size_t n = 0;
+  for (size_t i = 0; i < patterns.size(); i++) {
+    TopicCaptures expected;
+    if (!has_wildcard(patterns[i]) || !mqtt_topic_matches(patterns[i], topic, &expected)) continue;
+    if (n >= ids.size() || ids[n] != i || !same_captures(captures[n], expected) ||
+        !same_captures(CaptureLevels::of(patterns[i]).extract(topic), expected)) {
+      return false;
+    }
+    n++;
+  }
+  return n == ids.size() && captures.size() == ids.size();
+}
+
+bool check_equivalence() {
+  std::mt19937 rng(1);
+  std::vector<uint16_t> expected, actual, wildcard_ids;
+  std::vector<TopicCaptures> captures;
+  size_t checked = 0, mismatches = 0;
+  for (int round = 0; round < 500; round++) {
+    std::vector<std::string> patterns(1 + rng() % 40);
+    for (auto &pattern : patterns) pattern = random_topic(rng, true);
+    Indexes indexes(patterns);
+    for (int i = 0; i < 200; i++) {
+      const std::string topic = random_topic(rng, false);
+      linear_match(patterns, topic, expected);
+      indexes.match(topic, actual);
+      indexes.trie.match(topic, wildcard_ids, &captures);
+      checked++;
+      if ((actual != expected || !same_wildcard_matches(patterns, topic, wildcard_ids, captures)) &&
+          mismatches++ < 10) {
+        printf("mismatch on topic '%s'\n", topic.c_str());
+      }
+    }
+  }
+  printf("equivalence: %zu topics checked, %zu mismatches\n", checked, mismatches);
+  return mismatches == 0;
+}
+
+// A gateway-like subscription set over home/<room>/<device>/<metric>: mostly exact topics, some
+// per-device '+' patterns and a few '#' subtrees
+std::vector<std::string> gateway_patterns(std::mt19937 &rng, size_t count) {
+  std::vector<std::string> patterns;
+  while (patterns.size() < count) {
+    const std::string room = "room" + std::to_string(rng() % 20);
+    const std::string device = "dev" + std::to_string(rng() % 50);
+    const std::string metric = "m" + std::to_string(rng() % 8);
+    switch (rng() % 20) {
+      case 0:
+        patterns.push_back("home/" + room + "/#");
+        break;
+      case 1:
+      case 2:
+      case 3:
+        patterns.push_back("home/+/" + device + "/" + metric);
+        break;
+      case 4:
+      case 5:
+        patterns.push_back("home/" + room + "/+/" + metric);
+        break;
+      default:
+        patterns.push_back("home/" + room + "/" + device + "/" + metric);
+        break;
+    }
+  }
+  return patterns;
+}
+
+template<typename F> double ns_per_topic(const std::vector<std::string> &topics, size_t &sink, F match) {
+  std::vector<uint16_t> out;
+  out.reserve(1024);
+  const int passes = 20;
+  const auto start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < passes; pass++) {
+    for (const auto &topic : topics) {
+      match(topic, out);
+      sink += out.size();
+    }
+  }
+  const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / (passes * topics.size());
+}
+
+// Returns false if the three matchers found a different number of matches
+bool benchmark(size_t count) {
+  std::mt19937 rng(count);
+  const std::vector<std::string> patterns = gateway_patterns(rng, count);
+  std::vector<std::string> topics;
+  for (int i = 0; i < 2000; i++) {
+    topics.push_back("home/room" + std::to_string(rng() % 20) + "/dev" + std::to_string(rng() % 50) + "/m" +
+                     std::to_string(rng() % 8));
+  }
+  TopicIndex trie;
+  for (size_t i = 0; i < patterns.size(); i++) trie.add(patterns[i], i);
+  trie.finalize();
+  Indexes indexes(patterns);
+
+  size_t linear_sink = 0, trie_sink = 0, split_sink = 0;
+  const double linear = ns_per_topic(topics, linear_sink, [&](const std::string &topic, std::vector<uint16_t> &out) {
+    linear_match(patterns, topic, out);
+  });
+  const double trie_only = ns_per_topic(
+      topics, trie_sink, [&](const std::string &topic, std::vector<uint16_t> &out) { trie.match(topic, out); });
+  const double split = ns_per_topic(
+      topics, split_sink, [&](const std::string &topic, std::vector<uint16_t> &out) { indexes.match(topic, out); });
+  const bool same = linear_sink == trie_sink && trie_sink == split_sink;
+  printf("%5zu subscriptions: linear %9.1f ns  trie %7.1f ns  exact+trie %7.1f ns per topic  (%zu matches%s)\n",
+         count, linear, trie_only, split, linear_sink, same ? "" : ", DIFFER");
+  return same;
+}
+
+}  // namespace
+
+int main() {
+  if (!check_equivalence()) return 1;
+  bool same = true;
+  for (size_t count : {10, 100, 1000}) same &= benchmark(count);
+  return same ? 0 : 1;
+}